@@ -0,0 +1,7124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <limits.h>
+#include <stddef.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#include "engine.h"
+
+#define RESERVATION_FILE "reservations.dat"       // Legacy single file, migrated on startup
+#define LEGACY_BACKUP_FILE "reservations.dat.migrated"
+#define SEGMENT_DIR "segments"
+#define SEGMENT_LOCK_FILE "segments/segments.lock"
+#define COMMIT_LOCK_FILE "segments/commit.lock"    // Shared by writers, exclusive for snapshots
+#define FLIGHT_FILE "flights.dat"
+#define DATA_VERSION_FILE "data.version"
+#define DATA_VERSION_TEMP "data.version.tmp"
+#define DATA_VERSION 3                    // Layout of flights.dat and the change log
+#define TEMP_FILE "temp.dat"
+#define HOLD_FILE "holds.dat"
+#define PRICING_RULES_FILE "pricing.rules"   // Optional fare rules, built-in defaults otherwise
+#define PRICING_MAX_RULES 8                 // Load buckets / booking windows per rule set
+
+#define HOLD_WHEEL_SLOTS 512              // One slot per second, must exceed HOLD_TTL_SECONDS
+#define HOLD_TABLE_SIZE 65536             // Shared hold slots in HOLD_FILE (power of two)
+#define HOLD_PROBE_WINDOW 32              // Slots searched for one (flight, seat) key
+#define HOLD_POOL_SIZE 65536              // Holds one session can keep in flight
+#define PNR_INDEX_BUCKETS 64              // PNR index files under SEGMENT_DIR
+#define PNR_FILTER_FILE "segments/pnr.bloom"
+#define PNR_FILTER_MAGIC 0x504e5242u      // "PNRB"
+#define PNR_FILTER_BITS (1u << 24)        // About 1% false positives at 1.7M PNRs
+#define PNR_FILTER_HASHES 7
+#define PNR_ISSUE_ATTEMPTS 64             // Draws before a booking gives up on a full day
+
+#define URING_ENTRIES 64                  // io_uring submission queue depth
+#define URING_READ_CHUNK 65536            // Bytes per read request in flight
+#define STORAGE_BENCH_DIR "storage_bench"
+#define STORAGE_BENCH_FILES 16            // Segments written round-robin by the benchmark
+#define STORAGE_BENCH_BATCH 32            // Appends submitted together
+
+#define EXPORT_BUFFER_SIZE (1 << 20)      // Stdio buffer for export output and import input
+#define SNAPSHOT_READ_CHUNK 256           // Records read per fread while scanning a snapshot
+#define IMPORT_LINE_LEN 1024
+#define IMPORT_FIELDS 9                   // pnr .. status; booking_date is ignored
+#define IMPORT_FIELD_LEN 64
+#define SCHEDULE_FIELDS 7                 // flight .. base_fare; fare and seats are ignored
+#define IMPORT_OPEN_SEGMENTS 16           // Buffered segment files kept open by an import batch
+#define IMPORT_PNR_SLOTS (2 * CHANGE_LOG_BATCH)  // Hash set of the PNRs in one import batch
+#define IMPORT_SEGMENT_BUFFER (256 * 1024)
+#define IMPORT_INDEX_BUFFER (64 * 1024)
+
+#define SERIES_DIR "series"               // Per-flight booking time series
+
+#define ARCHIVE_DIR "archive"             // Read-only compressed segments of departed flights
+#define ARCHIVE_MAGIC 0x56435241u         // "ARCV"
+#define ARCHIVE_BLOCK_ROWS 1024           // Reservations per compressed block
+#define ARCHIVE_COLUMNS 8
+#define ARCHIVE_HASH_BITS 12              // Match finder table size of the column codec
+#define ARCHIVE_MIN_MATCH 4               // Shortest repeat worth encoding
+
+#define CHANGE_LOG_NAME "changes.log"
+#define CHANGE_LOG_ID_NAME "changes.id"       // Id of the current log, new whenever it starts over
+#define CHANGE_LOG_ID_TEMP "changes.id.tmp"
+#define CHANGE_LOG_BATCH 256              // Records written or replayed per batch
+#define REPLICA_STATE_FILE "replica.state"
+#define REPLICA_STATE_TEMP "replica.state.tmp"
+
+#define CHANGE_RESERVATION_APPEND 1
+#define CHANGE_RESERVATION_REPLACE 2
+#define CHANGE_RESERVATION_REMOVE 3
+#define CHANGE_FLIGHT_PUT 4
+#define CHANGE_FLIGHT_DELETE 5
+#define CHANGE_FLIGHT_ARCHIVE 6           // Flight's reservations moved to the archive tier
+#define CHANGE_FLAG_SNAPSHOT 1            // Seeded from existing data, not a live change
+#define CHANGE_FLAG_IMPORTED 2            // Bulk-imported; booked on the date in its PNR
+
+#define LISTING_PARTITIONS 8              // (status, payment method) pairs, each listed separately
+#define LISTING_CHUNK 512                 // Row ids per chunk of a sorted listing list
+#define LISTING_ORDER_FLIGHT 0
+#define LISTING_ORDER_NAME 1
+#define LISTING_CURSOR_VERSION 2
+
+#define MIN_CONNECTION_MINUTES 45         // Shortest layover offered
+#define MAX_CONNECTION_MINUTES (12 * 60)  // Longest layover offered
+
+typedef struct {
+    int flightNumber;
+    char destination[MAX_DEST_LEN + 1];
+    char departure[MAX_DEST_LEN + 1];
+    char time[MAX_TIME_LEN + 1];
+    float fare;
+    int availableSeats;
+    char date[MAX_DATE_LEN + 1];
+    int durationMinutes;
+} FlightV2;                           // flights.dat layout in data version 2
+
+typedef struct {
+    int flightNumber;
+    char destination[MAX_DEST_LEN + 1];
+    char departure[MAX_DEST_LEN + 1];
+    char time[MAX_TIME_LEN + 1];
+    float fare;
+    int availableSeats;
+} FlightV1;                           // flights.dat layout before data version 2
+
+typedef struct {
+    int flightNumber;                 // 0 marks an empty slot
+    int seatNumber;
+    long long expiresAt;              // Unix time the hold lapses
+    int ownerPid;                     // Session that placed the hold
+    int reserved;
+} SeatHoldSlot;
+
+typedef struct {
+    int flightNumber;
+    int seatNumber;
+    time_t expiresAt;
+    float fare;                       // Quote issued with the hold, honoured until it lapses
+    long slotIndex;                   // Position of the shared slot in HOLD_FILE
+    int next;                         // Timer wheel bucket / free list link
+    int prev;
+    int generation;                   // Invalidates stale handles after reuse
+    int inUse;
+} SeatHold;
+
+/* ================ UTILITY FUNCTIONS ================ */
+
+static void (*engineLogger)(const char *message) = NULL;  // EngineOptions.log
+
+/**
+ * Pass a warning or notice to the caller's log callback, if it set one
+ */
+static void engineLog(const char *format, ...) {
+    char message[512];
+    va_list args;
+    
+    if (!engineLogger) {
+        return;
+    }
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    engineLogger(message);
+}
+
+/**
+ * Initialize data files with proper binary mode
+ */
+static void initializeFiles() {
+    FILE *fp;
+    
+    // Initialize reservation segment directory
+    if (mkdir(SEGMENT_DIR, 0755) != 0 && errno != EEXIST) {
+        engineLog("Warning: Could not create/access reservation segments.");
+    }
+    
+    // Initialize flights file
+    fp = fopen(FLIGHT_FILE, "ab");
+    if (fp == NULL) {
+        engineLog("Warning: Could not create/access flights file.");
+    } else {
+        fclose(fp);
+    }
+}
+
+/**
+ * Order flight numbers
+ */
+static int compareFlightNumber(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+static unsigned int pnrSeed = 1;      // Seeded per process by seedPnrGenerator
+
+/**
+ * Seed the PNR generator from the clock and the process id
+ * A generator of its own leaves the embedding program's rand() alone, and
+ * sessions started in the same second still draw different PNRs
+ */
+static void seedPnrGenerator() {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    pnrSeed = (unsigned int)now.tv_sec ^ (unsigned int)now.tv_nsec ^ (unsigned int)getpid() << 16;
+}
+
+/**
+ * Generate a PNR from the booking date and a random number
+ * Callers retry until the PNR index has no entry for it (see issuePNR)
+ */
+static void generatePNR(char *pnr) {
+    time_t now = time(NULL);
+    struct tm *tm = localtime(&now);
+    int randomNum = rand_r(&pnrSeed) % 10000;
+    
+    // Format: YYMMDD + random 4 digits
+    snprintf(pnr, PNR_LEN + 1, "%02d%02d%02d%04d",
+             tm->tm_year % 100, tm->tm_mon + 1, tm->tm_mday, randomNum);
+}
+
+/* ================ STORAGE BACKENDS ================ */
+
+/*
+ * Reservation appends and segment reads go through a storage backend chosen
+ * at startup. The stdio backend is the original blocking fopen/fwrite path.
+ * On Linux the io_uring backend submits a whole batch of writes (and the
+ * fsyncs linked behind them) with a single system call, and reads a file as
+ * several chunks in flight at once.
+ */
+
+typedef struct {
+    const char *path;
+    const void *data;
+    size_t length;
+} StorageAppend;
+
+typedef struct {
+    const char *name;
+    int (*appendBatch)(const StorageAppend *appends, int count, int sync);
+    int (*readFile)(const char *path, void **data, size_t *length);
+} StorageBackend;
+
+/**
+ * Append each buffer to its file with stdio, optionally syncing to disk
+ */
+static int stdioAppendBatch(const StorageAppend *appends, int count, int sync) {
+    int ok = 1;
+    
+    for (int i = 0; i < count; i++) {
+        FILE *fp = fopen(appends[i].path, "ab");
+        if (!fp) {
+            ok = 0;
+            continue;
+        }
+        if (fwrite(appends[i].data, 1, appends[i].length, fp) != appends[i].length) {
+            ok = 0;
+        }
+        if (fflush(fp) != 0 || (sync && fsync(fileno(fp)) != 0)) {
+            ok = 0;
+        }
+        fclose(fp);
+    }
+    return ok;
+}
+
+/**
+ * Read a whole file into a malloc'd buffer with stdio
+ * A missing or empty file reads as *data = NULL; returns 0 only on an I/O
+ * error or short read, so callers never mistake a failed read for no data
+ */
+static int stdioReadFile(const char *path, void **data, size_t *length) {
+    FILE *fp = fopen(path, "rb");
+    *data = NULL;
+    *length = 0;
+    if (!fp) {
+        return errno == ENOENT;
+    }
+    
+    long size = -1;
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        size = ftell(fp);
+    }
+    if (size < 0 || fseek(fp, 0, SEEK_SET) != 0) {
+        fclose(fp);
+        return 0;
+    }
+    
+    void *buffer = size > 0 ? malloc(size) : NULL;
+    if (size > 0 && (!buffer || fread(buffer, 1, size, fp) != (size_t)size)) {
+        free(buffer);
+        fclose(fp);
+        return 0;
+    }
+    
+    fclose(fp);
+    *data = buffer;
+    *length = (size_t)size;
+    return 1;
+}
+
+static const StorageBackend stdioBackend = { "stdio", stdioAppendBatch, stdioReadFile };
+static const StorageBackend *storage = &stdioBackend;
+static int storageSync = 0;           // fsync reservation appends (--fsync)
+
+/**
+ * Sync a directory, so a file renamed into it survives a crash
+ */
+static int syncDirectory(const char *dir) {
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return 0;
+    }
+    int ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+#ifdef HAVE_IO_URING
+
+/*
+ * Minimal io_uring driver using the raw system calls, so the program does not
+ * depend on liburing. One ring is shared by the whole session.
+ */
+
+typedef struct {
+    int fd;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    unsigned pending;                 // Prepared but not yet submitted
+    void *sqRing, *cqRing;            // Mappings, kept for uringTeardown
+    size_t sqRingSize, cqRingSize, sqesSize;
+} UringQueue;
+
+static UringQueue uringQueue = { .fd = -1 };
+
+/**
+ * Unmap the queues and close the ring
+ */
+static void uringTeardown() {
+    if (uringQueue.sqRing && uringQueue.sqRing != MAP_FAILED) {
+        munmap(uringQueue.sqRing, uringQueue.sqRingSize);
+    }
+    if (uringQueue.cqRing && uringQueue.cqRing != MAP_FAILED) {
+        munmap(uringQueue.cqRing, uringQueue.cqRingSize);
+    }
+    if (uringQueue.sqes && (void *)uringQueue.sqes != MAP_FAILED) {
+        munmap(uringQueue.sqes, uringQueue.sqesSize);
+    }
+    if (uringQueue.fd >= 0) {
+        close(uringQueue.fd);
+    }
+    memset(&uringQueue, 0, sizeof(uringQueue));
+    uringQueue.fd = -1;
+}
+
+/**
+ * Create the ring and map its submission and completion queues
+ */
+static int uringSetup(unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) {
+        return 0;
+    }
+    
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    size_t sqeSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    
+    char *sq = mmap(NULL, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    fd, IORING_OFF_SQ_RING);
+    char *cq = mmap(NULL, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    fd, IORING_OFF_CQ_RING);
+    void *sqes = mmap(NULL, sqeSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd, IORING_OFF_SQES);
+    
+    uringQueue.fd = fd;
+    uringQueue.sqRing = sq;
+    uringQueue.cqRing = cq;
+    uringQueue.sqes = sqes;
+    uringQueue.sqRingSize = sqSize;
+    uringQueue.cqRingSize = cqSize;
+    uringQueue.sqesSize = sqeSize;
+    if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED) {
+        uringTeardown();
+        return 0;
+    }
+    
+    uringQueue.sqHead = (unsigned *)(sq + params.sq_off.head);
+    uringQueue.sqTail = (unsigned *)(sq + params.sq_off.tail);
+    uringQueue.sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+    uringQueue.sqArray = (unsigned *)(sq + params.sq_off.array);
+    uringQueue.cqHead = (unsigned *)(cq + params.cq_off.head);
+    uringQueue.cqTail = (unsigned *)(cq + params.cq_off.tail);
+    uringQueue.cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+    uringQueue.cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    uringQueue.pending = 0;
+    return 1;
+}
+
+/**
+ * Reserve the next submission queue entry
+ */
+static struct io_uring_sqe *uringNextSqe() {
+    unsigned tail = *uringQueue.sqTail + uringQueue.pending;
+    unsigned index = tail & *uringQueue.sqMask;
+    struct io_uring_sqe *sqe = &uringQueue.sqes[index];
+    
+    memset(sqe, 0, sizeof(*sqe));
+    uringQueue.sqArray[index] = index;
+    uringQueue.pending++;
+    return sqe;
+}
+
+/**
+ * Consume the completions already posted, clearing *ok on any failure
+ * Returns the number consumed
+ */
+static unsigned uringReap(const int *expected, int *ok) {
+    unsigned head = *uringQueue.cqHead;
+    unsigned tail = __atomic_load_n(uringQueue.cqTail, __ATOMIC_ACQUIRE);
+    unsigned reaped = 0;
+    
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &uringQueue.cqes[head & *uringQueue.cqMask];
+        if (cqe->res < 0 || (expected && cqe->res != expected[cqe->user_data])) {
+            *ok = 0;
+        }
+        head++;
+        reaped++;
+    }
+    __atomic_store_n(uringQueue.cqHead, head, __ATOMIC_RELEASE);
+    return reaped;
+}
+
+/**
+ * Submit all prepared entries and wait for every completion
+ * Returns 1 only if every operation completed with its expected result
+ *
+ * The caller frees its buffers as soon as this returns, so it never returns
+ * with an operation still in flight. If the rest of a batch cannot be
+ * submitted, what was submitted is waited out and the ring is replaced so
+ * the leftover entries never run; if no new ring can be set up, the session
+ * falls back to stdio.
+ */
+static int uringSubmitAndWait(const int *expected) {
+    unsigned count = uringQueue.pending;
+    if (count == 0) {
+        return 1;
+    }
+    
+    __atomic_store_n(uringQueue.sqTail, *uringQueue.sqTail + count, __ATOMIC_RELEASE);
+    uringQueue.pending = 0;
+    
+    int ok = 1;
+    unsigned submitted = 0, reaped = 0;
+    while (reaped < count) {
+        reaped += uringReap(expected, &ok);
+        if (reaped == count) {
+            break;
+        }
+        
+        long entered = syscall(__NR_io_uring_enter, uringQueue.fd, count - submitted, count - reaped,
+                               IORING_ENTER_GETEVENTS, NULL, 0);
+        if (entered >= 0) {
+            submitted += (unsigned)entered;
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;  // Nothing was submitted; try again
+        }
+        
+        while (reaped < submitted) {
+            if (syscall(__NR_io_uring_enter, uringQueue.fd, 0, submitted - reaped,
+                        IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR) {
+                break;
+            }
+            reaped += uringReap(expected, &ok);
+        }
+        uringTeardown();
+        if (!uringSetup(URING_ENTRIES)) {
+            storage = &stdioBackend;
+        }
+        return 0;
+    }
+    return ok;
+}
+
+/**
+ * Append a batch of buffers with one submission per URING_ENTRIES operations
+ * Each write is linked to its fsync so the sync only runs after the data lands
+ */
+static int uringAppendBatch(const StorageAppend *appends, int count, int sync) {
+    int fds[URING_ENTRIES];
+    int expected[URING_ENTRIES];
+    int perOp = sync ? 2 : 1;
+    int ok = 1;
+    
+    for (int start = 0; start < count; ) {
+        int batch = 0;
+        
+        while (start + batch < count && (batch + 1) * perOp <= URING_ENTRIES) {
+            const StorageAppend *a = &appends[start + batch];
+            int fd = open(a->path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+            if (fd < 0) {
+                ok = 0;
+                break;
+            }
+            fds[batch] = fd;
+            
+            struct io_uring_sqe *sqe = uringNextSqe();
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->fd = fd;
+            sqe->addr = (unsigned long)a->data;
+            sqe->len = (unsigned)a->length;
+            sqe->user_data = uringQueue.pending - 1;
+            expected[sqe->user_data] = (int)a->length;
+            
+            if (sync) {
+                sqe->flags |= IOSQE_IO_LINK;
+                sqe = uringNextSqe();
+                sqe->opcode = IORING_OP_FSYNC;
+                sqe->fd = fd;
+                sqe->user_data = uringQueue.pending - 1;
+                expected[sqe->user_data] = 0;
+            }
+            batch++;
+        }
+        
+        int submittedOk = uringSubmitAndWait(expected);
+        for (int i = 0; i < batch; i++) {
+            close(fds[i]);
+        }
+        if (!submittedOk) {
+            return 0;  // The ring may have been replaced; the batch has failed anyway
+        }
+        if (batch == 0) {
+            break;  // Could not open the next file
+        }
+        start += batch;
+    }
+    return ok;
+}
+
+/**
+ * Read a whole file with up to URING_ENTRIES chunk reads in flight
+ * Same results as stdioReadFile
+ */
+static int uringReadFile(const char *path, void **data, size_t *length) {
+    *data = NULL;
+    *length = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return errno == ENOENT;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return 0;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 1;
+    }
+    
+    char *buffer = malloc(st.st_size);
+    if (!buffer) {
+        close(fd);
+        return 0;
+    }
+    
+    int expected[URING_ENTRIES];
+    off_t offset = 0;
+    int ok = 1;
+    while (ok && offset < st.st_size) {
+        while (offset < st.st_size && uringQueue.pending < URING_ENTRIES) {
+            size_t chunk = st.st_size - offset;
+            if (chunk > URING_READ_CHUNK) {
+                chunk = URING_READ_CHUNK;
+            }
+            
+            struct io_uring_sqe *sqe = uringNextSqe();
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = fd;
+            sqe->off = offset;
+            sqe->addr = (unsigned long)(buffer + offset);
+            sqe->len = (unsigned)chunk;
+            sqe->user_data = uringQueue.pending - 1;
+            expected[sqe->user_data] = (int)chunk;
+            offset += chunk;
+        }
+        ok = uringSubmitAndWait(expected);
+    }
+    
+    close(fd);
+    if (!ok) {
+        free(buffer);
+        return 0;
+    }
+    *data = buffer;
+    *length = st.st_size;
+    return 1;
+}
+
+static const StorageBackend uringBackend = { "io_uring", uringAppendBatch, uringReadFile };
+
+#endif /* HAVE_IO_URING */
+
+/**
+ * Select the storage backend by name; falls back to stdio if unavailable
+ */
+int engineSelectStorage(const char *name) {
+    if (strcmp(name, "stdio") == 0) {
+        storage = &stdioBackend;
+        return 1;
+    }
+    
+#ifdef HAVE_IO_URING
+    if (strcmp(name, "io_uring") == 0) {
+        if (uringQueue.fd >= 0 || uringSetup(URING_ENTRIES)) {
+            storage = &uringBackend;
+            return 1;
+        }
+        engineLog("Warning: io_uring is not available here, using stdio.");
+        storage = &stdioBackend;
+        return 0;
+    }
+#endif
+    
+    engineLog("Warning: Unknown storage backend '%s', using stdio.", name);
+    storage = &stdioBackend;
+    return 0;
+}
+
+/**
+ * Time appends and reads on each available backend in a scratch directory
+ * and write the results to out
+ */
+void engineBenchmarkStorage(int records, FILE *out) {
+    const char *names[] = { "stdio", "io_uring" };
+    const StorageBackend *previous = storage;
+    Passenger *batch = calloc(STORAGE_BENCH_BATCH, sizeof(Passenger));
+    StorageAppend appends[STORAGE_BENCH_BATCH];
+    char paths[STORAGE_BENCH_FILES][64];
+    
+    if (!batch || (mkdir(STORAGE_BENCH_DIR, 0755) != 0 && errno != EEXIST)) {
+        fprintf(out, "Error: Could not prepare benchmark directory.\n");
+        free(batch);
+        return;
+    }
+    
+    for (int f = 0; f < STORAGE_BENCH_FILES; f++) {
+        snprintf(paths[f], sizeof(paths[f]), "%s/res_%d.dat", STORAGE_BENCH_DIR, f);
+    }
+    for (int i = 0; i < STORAGE_BENCH_BATCH; i++) {
+        snprintf(batch[i].name, sizeof(batch[i].name), "Bench Passenger %d", i);
+        batch[i].flightNumber = i % STORAGE_BENCH_FILES;
+        batch[i].isBooked = 1;
+    }
+    
+    fprintf(out, "\n%-10s %-6s %10s %12s %12s\n", "Backend", "fsync", "Records", "Appends/s", "Read MB/s");
+    fprintf(out, "------------------------------------------------------\n");
+    
+    for (int b = 0; b < 2; b++) {
+        if (!engineSelectStorage(names[b])) {
+            fprintf(out, "%-10s not available\n", names[b]);
+            continue;
+        }
+        
+        for (int sync = 0; sync <= 1; sync++) {
+            // fsync runs are much slower, so they use a tenth of the records
+            int total = sync ? records / 10 : records;
+            for (int f = 0; f < STORAGE_BENCH_FILES; f++) {
+                remove(paths[f]);
+            }
+            
+            struct timespec t0, t1, t2;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            for (int done = 0; done < total; done += STORAGE_BENCH_BATCH) {
+                int n = total - done < STORAGE_BENCH_BATCH ? total - done : STORAGE_BENCH_BATCH;
+                for (int i = 0; i < n; i++) {
+                    appends[i].path = paths[(done + i) % STORAGE_BENCH_FILES];
+                    appends[i].data = &batch[i];
+                    appends[i].length = sizeof(Passenger);
+                }
+                storage->appendBatch(appends, n, sync);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            
+            size_t bytes = 0;
+            for (int f = 0; f < STORAGE_BENCH_FILES; f++) {
+                void *data;
+                size_t length;
+                storage->readFile(paths[f], &data, &length);
+                free(data);
+                bytes += length;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &t2);
+            
+            double writeSecs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+            double readSecs = (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) / 1e9;
+            fprintf(out, "%-10s %-6s %10d %12.0f %12.1f\n", storage->name, sync ? "yes" : "no",
+                    total, writeSecs > 0 ? total / writeSecs : 0.0,
+                    readSecs > 0 ? bytes / readSecs / (1024.0 * 1024.0) : 0.0);
+        }
+    }
+    fprintf(out, "------------------------------------------------------\n");
+    
+    for (int f = 0; f < STORAGE_BENCH_FILES; f++) {
+        remove(paths[f]);
+    }
+    rmdir(STORAGE_BENCH_DIR);
+    free(batch);
+    storage = previous;
+}
+
+/* ================ CHANGE LOG ================ */
+
+/*
+ * Every change to reservations or flights is appended to a change log of
+ * fixed-size records, which followers replay to keep read replicas (see
+ * READ REPLICA below). Sessions sharing a log take an fcntl lock while
+ * appending, so sequence numbers stay dense and ordered; a record's
+ * sequence is its position in the file.
+ *
+ * A new log starts with a snapshot of the current flights and segments
+ * (initializeChangeLog) so a follower can rebuild the full state from the
+ * log alone.
+ *
+ * Sequence numbers restart with every new log, so a reader cannot tell a
+ * log that was started over from the one it was reading by position alone.
+ * CHANGE_LOG_ID_NAME next to the log holds an id that changes whenever the
+ * log starts over; readers remember it with their position.
+ */
+
+typedef struct {
+    long long sequence;               // 1-based position in the log
+    long long timestamp;              // Unix time the primary committed it
+    int type;                         // CHANGE_*
+    int flags;                        // CHANGE_FLAG_*
+    Passenger passenger;              // Reservation changes
+    Flight flight;                    // Flight changes
+} ChangeRecord;
+
+static char changeLogDir[EXPORT_PATH_LEN + 1] = CHANGE_LOG_DIR;
+static int changeLogEnabled = 1;      // Followers replay without logging
+static char followLogDir[EXPORT_PATH_LEN + 1] = "";  // Primary's log when following
+static long long replicaApplied = 0;  // Last sequence a follower applied
+static long long replicaLogId = 0;    // Id of the log replicaApplied refers to, 0 = not known yet
+
+/**
+ * Build the path of the change log inside a log directory
+ */
+static void changeLogPath(const char *dir, char *path, size_t size) {
+    snprintf(path, size, "%s/%s", dir, CHANGE_LOG_NAME);
+}
+
+/**
+ * Read the id of the change log in a directory, or 0 if it has none
+ */
+static long long readChangeLogId(const char *dir) {
+    char path[EXPORT_PATH_LEN + 32];
+    long long id = 0;
+    
+    snprintf(path, sizeof(path), "%s/%s", dir, CHANGE_LOG_ID_NAME);
+    FILE *fp = fopen(path, "r");
+    if (fp) {
+        if (fscanf(fp, "%lld", &id) != 1) {
+            id = 0;
+        }
+        fclose(fp);
+    }
+    return id;
+}
+
+/**
+ * Give the change log in a directory a new id
+ * Called before a new log is started, never after its first record
+ */
+static void writeChangeLogId(const char *dir) {
+    char path[EXPORT_PATH_LEN + 32], tempPath[EXPORT_PATH_LEN + 32];
+    struct timespec now;
+    
+    clock_gettime(CLOCK_REALTIME, &now);
+    long long id = ((long long)now.tv_sec << 30 ^ (long long)now.tv_nsec ^
+                    (long long)getpid() << 20) & LLONG_MAX;
+    if (id == 0) {
+        id = 1;
+    }
+    
+    snprintf(path, sizeof(path), "%s/%s", dir, CHANGE_LOG_ID_NAME);
+    snprintf(tempPath, sizeof(tempPath), "%s/%s", dir, CHANGE_LOG_ID_TEMP);
+    FILE *fp = fopen(tempPath, "w");
+    if (!fp) {
+        return;
+    }
+    fprintf(fp, "%lld\n", id);
+    if (fclose(fp) == 0) {
+        rename(tempPath, path);
+    }
+}
+
+/**
+ * Open a change log for reading, with its length in records and its id
+ * The id is read after the log is opened: a log that starts over gets its
+ * new id first, so a newer log is never paired with an older id
+ * Returns NULL if there is no log
+ */
+static FILE *openChangeLog(const char *dir, long long *records, long long *logId) {
+    char path[EXPORT_PATH_LEN + 32];
+    changeLogPath(dir, path, sizeof(path));
+    
+    *records = 0;
+    *logId = 0;
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    *records = ftell(fp) / (long)sizeof(ChangeRecord);
+    *logId = readChangeLogId(dir);
+    return fp;
+}
+
+/**
+ * Append change records, assigning their sequence numbers under the log lock
+ */
+static int logChanges(ChangeRecord *records, int count) {
+    char path[EXPORT_PATH_LEN + 32];
+    
+    if (!changeLogEnabled || count == 0) {
+        return 1;
+    }
+    
+    changeLogPath(changeLogDir, path, sizeof(path));
+    int fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        return 0;
+    }
+    
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    if (fcntl(fd, F_SETLKW, &lock) < 0) {
+        close(fd);
+        return 0;
+    }
+    
+    off_t size = lseek(fd, 0, SEEK_END);
+    long long next = size / (off_t)sizeof(ChangeRecord) + 1;
+    long long now = (long long)time(NULL);
+    for (int i = 0; i < count; i++) {
+        records[i].sequence = next + i;
+        records[i].timestamp = now;
+    }
+    
+    size_t bytes = sizeof(ChangeRecord) * count;
+    int ok = write(fd, records, bytes) == (ssize_t)bytes;
+    close(fd);  // Also drops the lock
+    return ok;
+}
+
+/**
+ * Log a change to one reservation
+ */
+static void logReservationChange(int type, const Passenger *p) {
+    ChangeRecord record;
+    memset(&record, 0, sizeof(record));
+    record.type = type;
+    record.passenger = *p;
+    logChanges(&record, 1);
+}
+
+/**
+ * Log a change to one flight
+ */
+static void logFlightChange(int type, const Flight *flight) {
+    ChangeRecord record;
+    memset(&record, 0, sizeof(record));
+    record.type = type;
+    record.flight = *flight;
+    logChanges(&record, 1);
+}
+
+/* ================ DATA VERSIONING ================ */
+
+/**
+ * Read the data version; files from before versioning count as version 1
+ */
+static int readDataVersion() {
+    int version = 0;
+    FILE *fp = fopen(DATA_VERSION_FILE, "r");
+    if (fp) {
+        if (fscanf(fp, "%d", &version) != 1) {
+            version = 0;
+        }
+        fclose(fp);
+        return version;
+    }
+    
+    struct stat st;
+    if (stat(FLIGHT_FILE, &st) == 0 && st.st_size > 0) {
+        return 1;
+    }
+    return DATA_VERSION;  // Fresh install
+}
+
+/**
+ * Record the data version the files are now in
+ */
+static void writeDataVersion(int version) {
+    // Replaced by rename, so a session starting meanwhile never reads it empty
+    FILE *fp = fopen(DATA_VERSION_TEMP, "w");
+    if (fp) {
+        fprintf(fp, "%d\n", version);
+        if (fclose(fp) == 0) {
+            rename(DATA_VERSION_TEMP, DATA_VERSION_FILE);
+        }
+    }
+}
+
+/**
+ * Convert flights.dat from an older layout: version 1 had no date or
+ * duration, version 2 no base fare
+ */
+static int migrateFlights(int version) {
+    FILE *fp = fopen(FLIGHT_FILE, "rb");
+    if (!fp) {
+        return 1;
+    }
+    
+    FILE *temp = fopen(TEMP_FILE, "wb");
+    if (!temp) {
+        fclose(fp);
+        return 0;
+    }
+    
+    FlightV1 v1;
+    FlightV2 v2;
+    Flight flight;
+    int count = 0;
+    while (1) {
+        memset(&flight, 0, sizeof(Flight));
+        if (version == 1) {
+            if (fread(&v1, sizeof(FlightV1), 1, fp) != 1) {
+                break;
+            }
+            flight.flightNumber = v1.flightNumber;
+            memcpy(flight.destination, v1.destination, sizeof(flight.destination));
+            memcpy(flight.departure, v1.departure, sizeof(flight.departure));
+            memcpy(flight.time, v1.time, sizeof(flight.time));
+            flight.fare = v1.fare;
+            flight.availableSeats = v1.availableSeats;
+        } else {
+            if (fread(&v2, sizeof(FlightV2), 1, fp) != 1) {
+                break;
+            }
+            flight.flightNumber = v2.flightNumber;
+            memcpy(flight.destination, v2.destination, sizeof(flight.destination));
+            memcpy(flight.departure, v2.departure, sizeof(flight.departure));
+            memcpy(flight.time, v2.time, sizeof(flight.time));
+            memcpy(flight.date, v2.date, sizeof(flight.date));
+            flight.fare = v2.fare;
+            flight.availableSeats = v2.availableSeats;
+            flight.durationMinutes = v2.durationMinutes;
+        }
+        flight.destination[MAX_DEST_LEN] = '\0';
+        flight.departure[MAX_DEST_LEN] = '\0';
+        flight.time[MAX_TIME_LEN] = '\0';
+        flight.date[MAX_DATE_LEN] = '\0';
+        flight.baseFare = flight.fare;  // Repriced from the base on the next booking
+        fwrite(&flight, sizeof(Flight), 1, temp);
+        count++;
+    }
+    
+    fclose(fp);
+    if (fclose(temp) != 0) {
+        remove(TEMP_FILE);
+        return 0;
+    }
+    rename(TEMP_FILE, FLIGHT_FILE);
+    engineLog("Upgraded %d flights to the new schedule format.", count);
+    return 1;
+}
+
+/**
+ * Bring data files up to DATA_VERSION
+ * Change log records embed the flight layout, so an upgrade starts a new
+ * log (reseeded from a snapshot); the old one is kept with a .v<N> suffix
+ */
+static void migrateDataFiles() {
+    int version = readDataVersion();
+    if (version >= DATA_VERSION) {
+        if (access(DATA_VERSION_FILE, F_OK) != 0) {
+            writeDataVersion(DATA_VERSION);
+        }
+        return;
+    }
+    
+    if (!migrateFlights(version)) {
+        engineLog("Warning: Could not upgrade %s.", FLIGHT_FILE);
+        return;
+    }
+    
+    char path[EXPORT_PATH_LEN + 32], oldPath[EXPORT_PATH_LEN + 48];
+    changeLogPath(changeLogDir, path, sizeof(path));
+    snprintf(oldPath, sizeof(oldPath), "%s.v%d", path, version);
+    writeChangeLogId(changeLogDir);  // Before the new log can get its first record
+    rename(path, oldPath);
+    
+    writeDataVersion(DATA_VERSION);
+}
+
+/* ================ PNR FILTER ================ */
+
+/*
+ * A Bloom filter over every PNR ever issued answers most lookups of unknown
+ * PNRs without reading the index or any segment. The filter file is mapped
+ * shared, so bits set by one session are seen immediately by the others.
+ * PNRs are never removed (cancelled bookings keep their record), so a plain
+ * Bloom filter is enough and never gives a false "not found".
+ *
+ * The header also keeps lookup counters for the statistics screen.
+ */
+
+typedef struct {
+    unsigned int magic;
+    unsigned int bits;
+    unsigned int hashes;
+    unsigned int reserved;
+    long long inserted;               // Entries added (a moved PNR is added again)
+    long long lookups;                // Checks made
+    long long definiteMisses;         // Checks answered "not issued" by the filter
+    long long falsePositives;         // Passed the filter but not in the index
+} BloomHeader;
+
+static unsigned char *bloomMap = NULL;  // Header followed by the bit array
+
+/**
+ * Two independent hashes of a PNR, combined by double hashing
+ */
+static void bloomHashes(const char *pnr, unsigned int *h1, unsigned int *h2) {
+    unsigned int fnv = 2166136261u, djb = 5381;
+    for (const char *c = pnr; *c; c++) {
+        fnv = (fnv ^ (unsigned char)*c) * 16777619u;
+        djb = djb * 33 + (unsigned char)*c;
+    }
+    *h1 = fnv;
+    *h2 = djb | 1;  // Odd step so probes cover the table
+}
+
+/**
+ * Record a newly issued PNR in the filter
+ */
+static void bloomAdd(const char *pnr) {
+    if (!bloomMap) {
+        return;
+    }
+    
+    BloomHeader *header = (BloomHeader *)bloomMap;
+    unsigned char *bitArray = bloomMap + sizeof(BloomHeader);
+    unsigned int h1, h2;
+    bloomHashes(pnr, &h1, &h2);
+    
+    for (unsigned int i = 0; i < header->hashes; i++) {
+        unsigned int bit = (h1 + i * h2) % header->bits;
+        __atomic_fetch_or(&bitArray[bit / 8], (unsigned char)(1u << (bit % 8)), __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&header->inserted, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Check whether a PNR may have been issued
+ * Returns 0 only if it was definitely never issued
+ */
+static int bloomMightContain(const char *pnr) {
+    if (!bloomMap) {
+        return 1;  // No filter, so every lookup has to check the index
+    }
+    
+    BloomHeader *header = (BloomHeader *)bloomMap;
+    unsigned char *bitArray = bloomMap + sizeof(BloomHeader);
+    unsigned int h1, h2;
+    bloomHashes(pnr, &h1, &h2);
+    
+    __atomic_fetch_add(&header->lookups, 1, __ATOMIC_RELAXED);
+    for (unsigned int i = 0; i < header->hashes; i++) {
+        unsigned int bit = (h1 + i * h2) % header->bits;
+        if (!(__atomic_load_n(&bitArray[bit / 8], __ATOMIC_RELAXED) & (1u << (bit % 8)))) {
+            __atomic_fetch_add(&header->definiteMisses, 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Count a lookup that passed the filter but found no PNR
+ */
+static void bloomRecordFalsePositive() {
+    if (bloomMap) {
+        __atomic_fetch_add(&((BloomHeader *)bloomMap)->falsePositives, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Report filter occupancy and how well it rejects unknown PNRs
+ */
+static void pnrFilterStats(EngineStats *stats) {
+    stats->filterAvailable = bloomMap != NULL;
+    if (!bloomMap) {
+        return;
+    }
+    
+    BloomHeader *header = (BloomHeader *)bloomMap;
+    unsigned char *bitArray = bloomMap + sizeof(BloomHeader);
+    long long setBits = 0;
+    for (unsigned int i = 0; i < header->bits / 8; i++) {
+        setBits += __builtin_popcount(bitArray[i]);
+    }
+    
+    // A miss passes the filter only if all of its probed bits are set
+    double fill = (double)setBits / header->bits;
+    double estimated = 1.0;
+    for (unsigned int i = 0; i < header->hashes; i++) {
+        estimated *= fill;
+    }
+    
+    stats->filterEntries = header->inserted;
+    stats->filterBits = header->bits;
+    stats->filterHashes = header->hashes;
+    stats->filterFill = fill;
+    stats->filterEstimatedRate = estimated;
+    stats->filterLookups = header->lookups;
+    stats->filterDefiniteMisses = header->definiteMisses;
+    stats->filterFalsePositives = header->falsePositives;
+}
+
+/* ================ BOOKING TIME SERIES ================ */
+
+/*
+ * Each flight has a time series of booking and cancellation counts in
+ * SERIES_DIR/ts_<flight>.dat, one 8-byte SeriesBucket per hour that saw an
+ * event. Events are added to the last bucket while its hour is open and
+ * start a new bucket after that, so the file only ever grows at its end
+ * and a flight that sells for a year takes at most 70KB. Booking curves
+ * and rates of sale are summed from the buckets and never read the
+ * reservations themselves.
+ *
+ * Moving a reservation to another flight counts as a cancellation on the
+ * old flight and a booking on the new one. A follower records the events
+ * it replays at the primary's commit time. Buckets may arrive out of
+ * order (imports are recorded at the booking date in their PNR); readers
+ * sort them.
+ */
+
+typedef struct {
+    int hour;                         // Hours since the Unix epoch
+    unsigned short booked;
+    unsigned short cancelled;
+} SeriesBucket;
+
+static time_t seriesClock = 0;        // Event time while replaying or importing, 0 = now
+
+/**
+ * Build the path of a flight's time series
+ */
+static void seriesPath(int flightNumber, char *path, size_t size) {
+    snprintf(path, size, "%s/ts_%d.dat", SERIES_DIR, flightNumber);
+}
+
+/**
+ * Add booking and cancellation counts to a flight's bucket for one hour
+ */
+static void seriesAdd(int flightNumber, int hour, int booked, int cancelled) {
+    char path[64];
+    seriesPath(flightNumber, path, sizeof(path));
+    
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return;  // No series directory yet; it is backfilled when created
+    }
+    
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    fcntl(fd, F_SETLKW, &lock);
+    
+    // Fold into the last bucket when it is the same hour and has room
+    SeriesBucket bucket;
+    off_t size = lseek(fd, 0, SEEK_END);
+    off_t at = size - size % (off_t)sizeof(SeriesBucket);
+    if (at > 0 && pread(fd, &bucket, sizeof(bucket), at - (off_t)sizeof(bucket)) == (ssize_t)sizeof(bucket) &&
+        bucket.hour == hour && bucket.booked + booked <= USHRT_MAX && bucket.cancelled + cancelled <= USHRT_MAX) {
+        at -= (off_t)sizeof(bucket);
+    } else {
+        memset(&bucket, 0, sizeof(bucket));
+        bucket.hour = hour;
+    }
+    
+    bucket.booked += (unsigned short)booked;
+    bucket.cancelled += (unsigned short)cancelled;
+    if (pwrite(fd, &bucket, sizeof(bucket), at) != (ssize_t)sizeof(bucket)) {
+        engineLog("Warning: Could not update the time series of flight %d.", flightNumber);
+    }
+    close(fd);  // Also drops the lock
+}
+
+/**
+ * Record the booking event a reservation change stands for
+ * A cancelled record appended directly (import, migration) is a booking
+ * that was later cancelled
+ */
+static void recordBookingEvent(int changeType, const Passenger *p) {
+    if (seriesClock < 0) {
+        return;
+    }
+    int hour = (int)((seriesClock ? seriesClock : time(NULL)) / 3600);
+    
+    switch (changeType) {
+        case CHANGE_RESERVATION_APPEND:
+            seriesAdd(p->flightNumber, hour, 1, !p->isBooked);
+            break;
+        case CHANGE_RESERVATION_REPLACE:
+            if (!p->isBooked) {
+                seriesAdd(p->flightNumber, hour, 0, 1);
+            }
+            break;
+        case CHANGE_RESERVATION_REMOVE:
+            seriesAdd(p->flightNumber, hour, 0, 1);
+            break;
+    }
+}
+
+/**
+ * Compare buckets by hour
+ */
+static int compareSeriesBuckets(const void *a, const void *b) {
+    int ha = ((const SeriesBucket *)a)->hour, hb = ((const SeriesBucket *)b)->hour;
+    return ha < hb ? -1 : ha > hb;
+}
+
+/**
+ * Load a flight's buckets in hour order
+ * Returns a malloc'd array (NULL if the flight has no series); *count is -1
+ * if the series could not be read
+ */
+static SeriesBucket *loadSeries(int flightNumber, int *count) {
+    char path[64];
+    void *data;
+    size_t length;
+    
+    seriesPath(flightNumber, path, sizeof(path));
+    if (!storage->readFile(path, &data, &length)) {
+        *count = -1;
+        return NULL;
+    }
+    SeriesBucket *buckets = data;
+    *count = (int)(length / sizeof(SeriesBucket));
+    if (buckets) {
+        qsort(buckets, *count, sizeof(SeriesBucket), compareSeriesBuckets);
+    }
+    return buckets;
+}
+
+/**
+ * Add one flight's events between two times to a rate of sale
+ * Returns 0 if the flight's series could not be read
+ */
+static int addSeriesRate(int flightNumber, time_t from, time_t to, SalesRate *rate) {
+    int count;
+    SeriesBucket *buckets = loadSeries(flightNumber, &count);
+    for (int i = 0; i < count; i++) {
+        time_t start = (time_t)buckets[i].hour * 3600;
+        if (start >= from && start < to) {
+            rate->booked += buckets[i].booked;
+            rate->cancelled += buckets[i].cancelled;
+        }
+    }
+    free(buckets);
+    return count >= 0;
+}
+
+/**
+ * Bookings per window for one flight, with the seats sold at each window's end
+ * Windows are windowHours long, aligned to the epoch, and run from the first
+ * event to the last; when there are more than maxPoints the latest are kept
+ */
+static int seriesCurve(int flightNumber, int windowHours, SeriesPoint *points, int maxPoints, int *count) {
+    int bucketCount;
+    SeriesBucket *buckets = loadSeries(flightNumber, &bucketCount);
+    
+    *count = 0;
+    if (bucketCount <= 0) {
+        free(buckets);
+        return bucketCount == 0;
+    }
+    
+    long first = buckets[0].hour / windowHours;
+    long last = buckets[bucketCount - 1].hour / windowHours;
+    long skip = last - first + 1 > maxPoints ? last - first + 1 - maxPoints : 0;
+    long sold = 0;
+    int b = 0;
+    
+    for (long w = first; w <= last; w++) {
+        long booked = 0, cancelled = 0;
+        while (b < bucketCount && buckets[b].hour / windowHours == w) {
+            booked += buckets[b].booked;
+            cancelled += buckets[b].cancelled;
+            b++;
+        }
+        sold += booked - cancelled;
+        
+        if (w - first >= skip) {
+            SeriesPoint *point = &points[(*count)++];
+            point->start = (time_t)w * windowHours * 3600;
+            point->booked = booked;
+            point->cancelled = cancelled;
+            point->sold = sold;
+        }
+    }
+    
+    free(buckets);
+    return 1;
+}
+
+/* ================ RESERVATION SEGMENTS ================ */
+
+/*
+ * Reservations are stored in one segment file per flight under SEGMENT_DIR,
+ * so per-flight operations only read and rewrite a small file. Writers lock
+ * the byte at offset flightNumber in SEGMENT_LOCK_FILE, which lets sessions
+ * working on different flights proceed in parallel. A write that cannot
+ * take its lock fails rather than running unprotected.
+ *
+ * PNR lookups are routed through an append-only index of (PNR, flight)
+ * entries, split into PNR_INDEX_BUCKETS files by a hash of the PNR. When a
+ * reservation moves to another flight a new entry is appended; the last
+ * entry for a PNR wins.
+ *
+ * Every write also runs as a commit: it holds a shared lock on
+ * COMMIT_LOCK_FILE, so writers never wait for each other there. Taking a
+ * snapshot (see SNAPSHOTS below) locks the file exclusively for the moment
+ * it needs to capture the segments, which it therefore never sees half
+ * written. Commits nest, so an engine call that touches several segments
+ * and flights.dat is captured either whole or not at all.
+ */
+
+typedef struct {
+    char pnr[PNR_LEN + 1];
+    int flightNumber;
+} PnrIndexEntry;
+
+/**
+ * Build the path of a flight's reservation segment
+ */
+static void segmentPath(int flightNumber, char *path, size_t size) {
+    snprintf(path, size, "%s/res_%d.dat", SEGMENT_DIR, flightNumber);
+}
+
+/**
+ * Open a flight's reservation segment
+ */
+static FILE *openSegment(int flightNumber, const char *mode) {
+    char path[64];
+    segmentPath(flightNumber, path, sizeof(path));
+    return fopen(path, mode);
+}
+
+/**
+ * Open the next segment of a directory listing, or NULL when done
+ */
+static FILE *openNextSegment(DIR *dir, int *flightNumber) {
+    struct dirent *entry;
+    
+    if (!dir) {
+        return NULL;
+    }
+    
+    while ((entry = readdir(dir)) != NULL) {
+        char suffix[8];
+        if (sscanf(entry->d_name, "res_%d.%7s", flightNumber, suffix) == 2 &&
+            strcmp(suffix, "dat") == 0) {
+            FILE *fp = openSegment(*flightNumber, "rb");
+            if (fp) {
+                return fp;
+            }
+        }
+    }
+    return NULL;
+}
+
+static int segmentLockFd = -1;        // One descriptor for the whole process, see lockSegment
+
+/**
+ * Lock or unlock one flight's byte in the segment lock file (F_WRLCK or F_UNLCK)
+ */
+static int setSegmentLock(int flightNumber, short type) {
+    if (segmentLockFd < 0) {
+        segmentLockFd = open(SEGMENT_LOCK_FILE, O_RDWR | O_CREAT, 0644);
+        if (segmentLockFd < 0) {
+            return 0;
+        }
+    }
+    
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    lock.l_start = flightNumber;
+    lock.l_len = 1;
+    while (fcntl(segmentLockFd, F_SETLKW, &lock) < 0) {
+        if (errno != EINTR) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Lock one flight's segment against other writers
+ * fcntl locks belong to the process, and closing any descriptor of the file
+ * drops all of them, so every segment lock goes through one descriptor that
+ * stays open. Locks do not nest: one unlockSegment releases the flight.
+ * Returns 1, or 0 if the lock could not be taken
+ */
+static int lockSegment(int flightNumber) {
+    return setSegmentLock(flightNumber, F_WRLCK);
+}
+
+/**
+ * Release a segment lock taken with lockSegment
+ */
+static void unlockSegment(int flightNumber) {
+    setSegmentLock(flightNumber, F_UNLCK);
+}
+
+static int commitLockFd = -1;
+static int commitDepth = 0;           // Nested beginCommit calls in this process
+
+/**
+ * Lock or unlock the whole commit lock file (F_RDLCK, F_WRLCK or F_UNLCK)
+ */
+static int lockCommitFile(short type) {
+    if (commitLockFd < 0) {
+        commitLockFd = open(COMMIT_LOCK_FILE, O_RDWR | O_CREAT, 0644);
+        if (commitLockFd < 0) {
+            return 0;
+        }
+    }
+    
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    return fcntl(commitLockFd, F_SETLKW, &lock) == 0;
+}
+
+/**
+ * Start a commit; snapshots wait until the outermost one ends
+ */
+static void beginCommit() {
+    if (commitDepth++ == 0) {
+        lockCommitFile(F_RDLCK);
+    }
+}
+
+/**
+ * End a commit started with beginCommit
+ */
+static void endCommit() {
+    if (--commitDepth == 0) {
+        lockCommitFile(F_UNLCK);
+    }
+}
+
+/**
+ * Pick the PNR index bucket for a PNR
+ */
+static int pnrIndexBucket(const char *pnr) {
+    unsigned int h = 5381;
+    for (const char *c = pnr; *c; c++) {
+        h = h * 33 + (unsigned char)*c;
+    }
+    return (int)(h % PNR_INDEX_BUCKETS);
+}
+
+/**
+ * Build the path of a PNR index bucket file
+ */
+static void pnrIndexPath(int bucket, char *path, size_t size) {
+    snprintf(path, size, "%s/pnr_%02x.idx", SEGMENT_DIR, bucket);
+}
+
+/**
+ * Find the flight whose segment holds a PNR, or -1 if it was never issued
+ * Returns -2 if the index could not be read
+ */
+static int findReservationFlight(const char *pnr) {
+    char path[64];
+    void *data;
+    size_t length;
+    
+    if (!bloomMightContain(pnr)) {
+        return -1;  // Never issued, no need to read the index
+    }
+    
+    pnrIndexPath(pnrIndexBucket(pnr), path, sizeof(path));
+    if (!storage->readFile(path, &data, &length)) {
+        return -2;
+    }
+    PnrIndexEntry *entries = data;
+    if (!entries) {
+        bloomRecordFalsePositive();
+        return -1;
+    }
+    
+    int flightNumber = -1;
+    size_t count = length / sizeof(PnrIndexEntry);
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(entries[i].pnr, pnr) == 0) {
+            flightNumber = entries[i].flightNumber;  // Keep going, last entry wins
+        }
+    }
+    
+    free(entries);
+    if (flightNumber == -1) {
+        bloomRecordFalsePositive();
+    }
+    return flightNumber;
+}
+
+/**
+ * Generate a PNR that has never been issued, archived PNRs included
+ * Call inside a commit, just before the reservation is appended
+ * Returns ENGINE_OK, or ENGINE_ERROR if the index could not be read or no
+ * free PNR was drawn in PNR_ISSUE_ATTEMPTS tries
+ */
+static int issuePNR(char *pnr) {
+    for (int attempt = 0; attempt < PNR_ISSUE_ATTEMPTS; attempt++) {
+        generatePNR(pnr);
+        int flightNumber = findReservationFlight(pnr);
+        if (flightNumber == -1) {
+            return ENGINE_OK;
+        }
+        if (flightNumber == -2) {
+            return ENGINE_ERROR;
+        }
+    }
+    engineLog("Warning: No unused PNR found for today after %d tries.", PNR_ISSUE_ATTEMPTS);
+    return ENGINE_ERROR;
+}
+
+/**
+ * Append a reservation to its flight's segment and index its PNR
+ * The caller holds the flight's segment lock
+ */
+static int appendReservationLocked(const Passenger *p) {
+    PnrIndexEntry entry;
+    char path[64], indexPath[64];
+    
+    memset(&entry, 0, sizeof(entry));
+    snprintf(entry.pnr, sizeof(entry.pnr), "%s", p->pnr);
+    entry.flightNumber = p->flightNumber;
+    
+    segmentPath(p->flightNumber, path, sizeof(path));
+    pnrIndexPath(pnrIndexBucket(p->pnr), indexPath, sizeof(indexPath));
+    
+    // The record and its index entry are submitted together. The filter
+    // learns the PNR first: a crash after the append must not leave a stored
+    // PNR the filter calls unissued, while a failed append only leaves a
+    // false positive
+    StorageAppend appends[2] = {
+        { path, p, sizeof(Passenger) },
+        { indexPath, &entry, sizeof(PnrIndexEntry) }
+    };
+    
+    bloomAdd(p->pnr);
+    int ok = storage->appendBatch(appends, 2, storageSync);
+    if (ok) {
+        logReservationChange(CHANGE_RESERVATION_APPEND, p);
+        recordBookingEvent(CHANGE_RESERVATION_APPEND, p);
+    }
+    return ok;
+}
+
+/**
+ * Append a reservation to its flight's segment and index its PNR
+ */
+static int appendReservation(const Passenger *p) {
+    beginCommit();
+    if (!lockSegment(p->flightNumber)) {
+        endCommit();
+        return 0;
+    }
+    int ok = appendReservationLocked(p);
+    unlockSegment(p->flightNumber);
+    endCommit();
+    return ok;
+}
+
+/**
+ * Load a flight's whole segment into memory
+ * Returns a malloc'd array (NULL if the segment is empty or missing); *count
+ * is -1 if the segment could not be read
+ */
+static Passenger *loadSegment(int flightNumber, int *count) {
+    char path[64];
+    void *data;
+    size_t length;
+    
+    segmentPath(flightNumber, path, sizeof(path));
+    if (!storage->readFile(path, &data, &length)) {
+        *count = -1;
+        return NULL;
+    }
+    *count = (int)(length / sizeof(Passenger));
+    return data;
+}
+
+/**
+ * Look up an active reservation by PNR
+ * Returns 1 if found, 0 if not, -1 if its index or segment could not be read
+ */
+static int findReservation(const char *pnr, Passenger *out) {
+    int flightNumber = findReservationFlight(pnr);
+    if (flightNumber < 0) {
+        return flightNumber == -1 ? 0 : -1;
+    }
+    
+    int count;
+    Passenger *records = loadSegment(flightNumber, &count);
+    if (count < 0) {
+        return -1;
+    }
+    
+    int found = 0;
+    for (int i = 0; i < count; i++) {
+        if (strcmp(records[i].pnr, pnr) == 0 && records[i].isBooked) {
+            *out = records[i];
+            found = 1;
+            break;
+        }
+    }
+    
+    free(records);
+    return found;
+}
+
+/**
+ * Replace the active reservation for a PNR within one flight's segment
+ * A NULL replacement removes the record (used when it moves flights)
+ * The segment is rewritten to a temporary file that only replaces it once
+ * fully written (and synced, with --fsync)
+ * The caller holds the flight's segment lock
+ * Returns 1 once replaced, 0 if the PNR is not active in the segment, or -1
+ * if the segment could not be read or rewritten
+ */
+static int replaceReservationLocked(int flightNumber, const char *pnr, const Passenger *replacement) {
+    char path[64], tempPath[64];
+    segmentPath(flightNumber, path, sizeof(path));
+    snprintf(tempPath, sizeof(tempPath), "%s/res_%d.tmp", SEGMENT_DIR, flightNumber);
+    
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    
+    FILE *temp = fopen(tempPath, "wb");
+    if (!temp) {
+        fclose(fp);
+        return -1;
+    }
+    
+    Passenger p;
+    int found = 0, ok = 1;
+    while (ok && fread(&p, sizeof(Passenger), 1, fp) == 1) {
+        if (!found && strcmp(p.pnr, pnr) == 0 && p.isBooked) {
+            found = 1;
+            if (replacement) {
+                ok = fwrite(replacement, sizeof(Passenger), 1, temp) == 1;
+            }
+            continue;
+        }
+        ok = fwrite(&p, sizeof(Passenger), 1, temp) == 1;
+    }
+    
+    ok = ok && !ferror(fp) && fflush(temp) == 0 && (!storageSync || fsync(fileno(temp)) == 0);
+    fclose(fp);
+    if (fclose(temp) != 0) {
+        ok = 0;
+    }
+    if (!ok || !found || rename(tempPath, path) != 0) {
+        remove(tempPath);
+        return ok && !found ? 0 : -1;
+    }
+    if (storageSync && !syncDirectory(SEGMENT_DIR)) {
+        // The change is made and visible; only its durability is in doubt
+        engineLog("Warning: Could not sync %s after rewriting %s.", SEGMENT_DIR, path);
+    }
+    
+    if (replacement) {
+        logReservationChange(CHANGE_RESERVATION_REPLACE, replacement);
+        recordBookingEvent(CHANGE_RESERVATION_REPLACE, replacement);
+    } else {
+        Passenger removed;
+        memset(&removed, 0, sizeof(removed));
+        snprintf(removed.pnr, sizeof(removed.pnr), "%s", pnr);
+        removed.flightNumber = flightNumber;
+        logReservationChange(CHANGE_RESERVATION_REMOVE, &removed);
+        recordBookingEvent(CHANGE_RESERVATION_REMOVE, &removed);
+    }
+    return 1;
+}
+
+/**
+ * Replace the active reservation for a PNR within one flight's segment
+ * A NULL replacement removes the record (used when it moves flights)
+ * Returns 1 once replaced, 0 if the PNR is not active there, or -1 on error
+ */
+static int replaceReservation(int flightNumber, const char *pnr, const Passenger *replacement) {
+    beginCommit();
+    if (!lockSegment(flightNumber)) {
+        endCommit();
+        return -1;
+    }
+    int found = replaceReservationLocked(flightNumber, pnr, replacement);
+    unlockSegment(flightNumber);
+    endCommit();
+    return found;
+}
+
+/**
+ * Move reservations from the legacy single file into flight segments
+ */
+static void migrateLegacyReservations() {
+    FILE *fp = fopen(RESERVATION_FILE, "rb");
+    if (!fp) {
+        return;
+    }
+    
+    Passenger p;
+    int moved = 0;
+    while (fread(&p, sizeof(Passenger), 1, fp) == 1) {
+        if (appendReservation(&p)) {
+            moved++;
+        }
+    }
+    fclose(fp);
+    
+    if (moved > 0) {
+        rename(RESERVATION_FILE, LEGACY_BACKUP_FILE);
+        engineLog("Moved %d reservations into per-flight segments.", moved);
+    }
+}
+
+/**
+ * Map the shared PNR filter, building it from the PNR index if it is new
+ */
+static void openPnrFilter() {
+    size_t size = sizeof(BloomHeader) + PNR_FILTER_BITS / 8;
+    int fd = open(PNR_FILTER_FILE, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        engineLog("Warning: Could not open PNR filter; lookups will read the index.");
+        return;
+    }
+    
+    // Serialise the first-time build between sessions starting together
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    fcntl(fd, F_SETLKW, &lock);
+    
+    struct stat st;
+    int isNew = fstat(fd, &st) == 0 && st.st_size == 0;
+    if ((isNew && ftruncate(fd, size) != 0) || (!isNew && (size_t)st.st_size != size)) {
+        engineLog("Warning: PNR filter has an unexpected size; lookups will read the index.");
+        close(fd);
+        return;
+    }
+    
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return;
+    }
+    bloomMap = map;
+    
+    BloomHeader *header = (BloomHeader *)bloomMap;
+    if (isNew || header->magic != PNR_FILTER_MAGIC) {
+        memset(bloomMap, 0, size);
+        header->bits = PNR_FILTER_BITS;
+        header->hashes = PNR_FILTER_HASHES;
+        
+        // Add every PNR already in the index
+        for (int bucket = 0; bucket < PNR_INDEX_BUCKETS; bucket++) {
+            char path[64];
+            PnrIndexEntry entry;
+            pnrIndexPath(bucket, path, sizeof(path));
+            FILE *fp = fopen(path, "rb");
+            while (fp && fread(&entry, sizeof(PnrIndexEntry), 1, fp) == 1) {
+                bloomAdd(entry.pnr);
+            }
+            if (fp) {
+                fclose(fp);
+            }
+        }
+        header->magic = PNR_FILTER_MAGIC;
+        msync(bloomMap, size, MS_SYNC);
+    }
+    
+    close(fd);  // The mapping stays valid; closing drops the lock
+}
+
+/* ================ ARCHIVE SEGMENTS ================ */
+
+/*
+ * Reservations on flights that have departed are moved out of the hot
+ * segments into one read-only archive file per flight under ARCHIVE_DIR.
+ * An archive is stored by column rather than by record, in blocks of
+ * ARCHIVE_BLOCK_ROWS reservations, and each column of a block is compressed
+ * on its own: PNRs share their date prefix, fares, ages and payment methods
+ * repeat, and names lose the padding of the fixed-size record. Readers only
+ * decompress the columns they need, so a revenue total reads the fare and
+ * status columns and a PNR lookup reads the PNR column until it finds a
+ * match.
+ *
+ * The codec is a small LZ77 variant with a 64KB window. A control byte
+ * below 0x80 starts a run of (byte + 1) literals; otherwise it is a match
+ * of (byte & 0x7f) + ARCHIVE_MIN_MATCH bytes at a two-byte offset back.
+ * Columns that do not shrink are stored as they are.
+ *
+ * Archives are written whole to a temporary file and renamed into place,
+ * then the hot segment is removed, in one commit. An open archive
+ * therefore never changes, which lets snapshots pin it like a segment.
+ * Cancelling or modifying an archived reservation is refused, and so is
+ * booking an archived flight.
+ *
+ * The numbers of the archived flights are kept in memory and read again
+ * only when ARCHIVE_DIR changes, so seat checks on flights that were never
+ * archived do not open the archive tier at all.
+ */
+
+#define ARCHIVE_COL_PNR 0
+#define ARCHIVE_COL_NAME 1
+#define ARCHIVE_COL_AGE 2
+#define ARCHIVE_COL_GENDER 3
+#define ARCHIVE_COL_SEAT 4
+#define ARCHIVE_COL_FARE 5
+#define ARCHIVE_COL_PAYMENT 6
+#define ARCHIVE_COL_STATUS 7
+#define ARCHIVE_ALL_COLUMNS ((1 << ARCHIVE_COLUMNS) - 1)
+
+typedef struct {
+    unsigned int magic;               // ARCHIVE_MAGIC
+    int flightNumber;
+    int records;
+    int blockCount;
+    long long rawBytes;               // Size of the records as a hot segment
+} ArchiveHeader;
+
+typedef struct {
+    int rows;
+    unsigned int offset[ARCHIVE_COLUMNS];   // Column data, from the start of the file
+    unsigned int length[ARCHIVE_COLUMNS];   // Bytes stored
+    unsigned int rawLength[ARCHIVE_COLUMNS];// Bytes decompressed (equal to length: stored as is)
+} ArchiveBlock;
+
+typedef struct {
+    int *flights;                     // Sorted
+    int count;
+    int cap;
+    int loaded;
+    struct timespec modified;         // ARCHIVE_DIR mtime when last read
+    time_t checked;                   // When it was last read
+} ArchivedFlightSet;
+
+static ArchivedFlightSet archivedFlights;
+
+typedef struct {
+    FILE *fp;                         // Not owned by the reader
+    ArchiveHeader header;
+    ArchiveBlock *blocks;
+    unsigned char *raw;               // One decompressed column
+    unsigned char *packed;            // One column as stored
+    Passenger *rows;                  // Decoded rows of the current block
+} ArchiveReader;
+
+/**
+ * Build the path of a flight's archive
+ */
+static void archivePath(int flightNumber, char *path, size_t size) {
+    snprintf(path, size, "%s/arc_%d.dat", ARCHIVE_DIR, flightNumber);
+}
+
+/**
+ * Open a flight's archive for reading, or NULL if it has none
+ */
+static FILE *openArchive(int flightNumber) {
+    char path[64];
+    archivePath(flightNumber, path, sizeof(path));
+    return fopen(path, "rb");
+}
+
+/**
+ * Re-read the archived flight numbers if ARCHIVE_DIR may have changed
+ * Directory times are only as fine as the kernel's clock tick, so, as with
+ * flights.dat, the list is trusted only once the directory's mtime is
+ * clearly older than the read that produced it
+ */
+static void syncArchivedFlights() {
+    ArchivedFlightSet *set = &archivedFlights;
+    struct stat st;
+    
+    if (stat(ARCHIVE_DIR, &st) != 0) {
+        set->count = 0;  // Nothing archived yet
+        set->loaded = 0;
+        return;
+    }
+    if (set->loaded &&
+        st.st_mtim.tv_sec == set->modified.tv_sec &&
+        st.st_mtim.tv_nsec == set->modified.tv_nsec &&
+        st.st_mtim.tv_sec + 1 < set->checked) {
+        return;
+    }
+    
+    DIR *dir = opendir(ARCHIVE_DIR);
+    struct dirent *entry;
+    set->checked = time(NULL);
+    set->count = 0;
+    set->loaded = dir != NULL;
+    while (dir && (entry = readdir(dir)) != NULL) {
+        int flightNumber;
+        char suffix[8];
+        if (sscanf(entry->d_name, "arc_%d.%7s", &flightNumber, suffix) != 2 || strcmp(suffix, "dat") != 0) {
+            continue;
+        }
+        if (set->count == set->cap) {
+            int newCap = set->cap ? set->cap * 2 : 64;
+            int *grown = realloc(set->flights, newCap * sizeof(int));
+            if (!grown) {
+                set->loaded = 0;  // Incomplete; read again next time
+                break;
+            }
+            set->flights = grown;
+            set->cap = newCap;
+        }
+        set->flights[set->count++] = flightNumber;
+    }
+    if (dir) {
+        closedir(dir);
+    }
+    qsort(set->flights, set->count, sizeof(int), compareFlightNumber);
+    set->modified = st.st_mtim;
+}
+
+/**
+ * Check whether a flight's reservations have been moved to the archive
+ * Returns -1 if ARCHIVE_DIR exists but could not be listed
+ */
+static int isFlightArchived(int flightNumber) {
+    syncArchivedFlights();
+    if (!archivedFlights.loaded) {
+        return access(ARCHIVE_DIR, F_OK) == 0 ? -1 : 0;
+    }
+    return bsearch(&flightNumber, archivedFlights.flights, archivedFlights.count,
+                   sizeof(int), compareFlightNumber) != NULL;
+}
+
+/**
+ * Flush a run of literals to compressed output
+ */
+static size_t archiveLiterals(const unsigned char *in, size_t n, unsigned char *out) {
+    size_t o = 0;
+    while (n > 0) {
+        size_t run = n < 128 ? n : 128;
+        out[o++] = (unsigned char)(run - 1);
+        memcpy(out + o, in, run);
+        o += run;
+        in += run;
+        n -= run;
+    }
+    return o;
+}
+
+/**
+ * Compress one column; out must hold n + n / 128 + 1 bytes
+ * Returns the compressed length
+ */
+static size_t archiveCompress(const unsigned char *in, size_t n, unsigned char *out) {
+    int table[1 << ARCHIVE_HASH_BITS];  // Last position of each hashed 4-byte sequence
+    size_t i = 0, o = 0, literals = 0;
+    
+    for (int h = 0; h < (1 << ARCHIVE_HASH_BITS); h++) {
+        table[h] = -1;
+    }
+    
+    while (i + ARCHIVE_MIN_MATCH <= n) {
+        unsigned int word = in[i] | in[i + 1] << 8 | in[i + 2] << 16 | (unsigned int)in[i + 3] << 24;
+        unsigned int h = (word * 2654435761u) >> (32 - ARCHIVE_HASH_BITS);
+        int candidate = table[h];
+        table[h] = (int)i;
+        
+        if (candidate < 0 || i - candidate > 0xffff || memcmp(in + candidate, in + i, ARCHIVE_MIN_MATCH) != 0) {
+            i++;
+            continue;
+        }
+        
+        size_t length = ARCHIVE_MIN_MATCH;
+        while (i + length < n && length < ARCHIVE_MIN_MATCH + 127 && in[candidate + length] == in[i + length]) {
+            length++;
+        }
+        size_t offset = i - candidate;
+        o += archiveLiterals(in + literals, i - literals, out + o);
+        out[o++] = (unsigned char)(0x80 | (length - ARCHIVE_MIN_MATCH));
+        out[o++] = (unsigned char)(offset & 0xff);
+        out[o++] = (unsigned char)(offset >> 8);
+        i += length;
+        literals = i;
+    }
+    
+    o += archiveLiterals(in + literals, n - literals, out + o);
+    return o;
+}
+
+/**
+ * Decompress one column of exactly rawLength bytes
+ */
+static int archiveDecompress(const unsigned char *in, size_t n, unsigned char *out, size_t rawLength) {
+    size_t i = 0, o = 0;
+    
+    while (i < n) {
+        unsigned char c = in[i++];
+        if (c & 0x80) {
+            size_t length = (c & 0x7f) + ARCHIVE_MIN_MATCH;
+            if (i + 2 > n) {
+                return 0;
+            }
+            size_t offset = in[i] | in[i + 1] << 8;
+            i += 2;
+            if (offset == 0 || offset > o || o + length > rawLength) {
+                return 0;
+            }
+            for (size_t k = 0; k < length; k++, o++) {
+                out[o] = out[o - offset];  // Byte by byte, matches may overlap
+            }
+        } else {
+            size_t length = (size_t)c + 1;
+            if (i + length > n || o + length > rawLength) {
+                return 0;
+            }
+            memcpy(out + o, in + i, length);
+            i += length;
+            o += length;
+        }
+    }
+    return o == rawLength;
+}
+
+/**
+ * Lay out one column of a block; returns its length in raw
+ */
+static size_t archiveColumn(int column, const Passenger *rows, int count, unsigned char *raw) {
+    size_t n = 0;
+    for (int i = 0; i < count; i++) {
+        const Passenger *p = &rows[i];
+        switch (column) {
+            case ARCHIVE_COL_PNR:
+                memcpy(raw + n, p->pnr, PNR_LEN);
+                n += PNR_LEN;
+                break;
+            case ARCHIVE_COL_NAME: {
+                size_t len = strnlen(p->name, MAX_NAME_LEN);
+                memcpy(raw + n, p->name, len);
+                raw[n + len] = '\0';
+                n += len + 1;
+                break;
+            }
+            case ARCHIVE_COL_AGE: raw[n++] = (unsigned char)p->age; break;
+            case ARCHIVE_COL_GENDER: raw[n++] = (unsigned char)p->gender; break;
+            case ARCHIVE_COL_SEAT: raw[n++] = (unsigned char)p->seatNumber; break;
+            case ARCHIVE_COL_FARE:
+                memcpy(raw + n, &p->fare, sizeof(float));
+                n += sizeof(float);
+                break;
+            case ARCHIVE_COL_PAYMENT: raw[n++] = (unsigned char)p->paymentMethod; break;
+            case ARCHIVE_COL_STATUS: raw[n++] = (unsigned char)p->isBooked; break;
+        }
+    }
+    return n;
+}
+
+/**
+ * Fill one column of a block's rows from its decompressed bytes
+ */
+static int unpackArchiveColumn(int column, const unsigned char *raw, size_t n, Passenger *rows, int count) {
+    size_t at = 0;
+    
+    // PNRs are stored at the width they had when archived (9 before PNR_LEN grew)
+    size_t pnrWidth = count > 0 ? n / count : PNR_LEN;
+    if (column == ARCHIVE_COL_PNR) {
+        if (pnrWidth < 1 || pnrWidth > PNR_LEN || n != pnrWidth * count) {
+            return 0;
+        }
+    } else if (column == ARCHIVE_COL_FARE) {
+        if (n != sizeof(float) * count) {
+            return 0;
+        }
+    } else if (column != ARCHIVE_COL_NAME && n != (size_t)count) {
+        return 0;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        Passenger *p = &rows[i];
+        switch (column) {
+            case ARCHIVE_COL_PNR:
+                memcpy(p->pnr, raw + i * pnrWidth, pnrWidth);
+                p->pnr[pnrWidth] = '\0';
+                break;
+            case ARCHIVE_COL_NAME: {
+                const unsigned char *end = memchr(raw + at, '\0', n - at);
+                size_t len = end ? (size_t)(end - (raw + at)) : MAX_NAME_LEN + 1;
+                if (len > MAX_NAME_LEN) {
+                    return 0;
+                }
+                memcpy(p->name, raw + at, len + 1);
+                at += len + 1;
+                break;
+            }
+            case ARCHIVE_COL_AGE: p->age = raw[i]; break;
+            case ARCHIVE_COL_GENDER: p->gender = (char)raw[i]; break;
+            case ARCHIVE_COL_SEAT: p->seatNumber = raw[i]; break;
+            case ARCHIVE_COL_FARE: memcpy(&p->fare, raw + i * sizeof(float), sizeof(float)); break;
+            case ARCHIVE_COL_PAYMENT: p->paymentMethod = raw[i]; break;
+            case ARCHIVE_COL_STATUS: p->isBooked = raw[i]; break;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Write a flight's reservations as a new archive file
+ */
+static int writeArchive(const char *path, int flightNumber, const Passenger *records, int count) {
+    size_t columnMax = (size_t)ARCHIVE_BLOCK_ROWS * (MAX_NAME_LEN + 1);
+    ArchiveHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = ARCHIVE_MAGIC;
+    header.flightNumber = flightNumber;
+    header.records = count;
+    header.blockCount = (count + ARCHIVE_BLOCK_ROWS - 1) / ARCHIVE_BLOCK_ROWS;
+    header.rawBytes = (long long)count * sizeof(Passenger);
+    
+    FILE *fp = fopen(path, "wb");
+    ArchiveBlock *blocks = calloc(header.blockCount + 1, sizeof(ArchiveBlock));
+    unsigned char *raw = malloc(columnMax);
+    unsigned char *packed = malloc(columnMax + columnMax / 128 + 1);
+    int ok = fp && blocks && raw && packed;
+    
+    // Column data follows the header and block directory
+    long offset = (long)sizeof(ArchiveHeader) + (long)header.blockCount * (long)sizeof(ArchiveBlock);
+    if (ok) {
+        ok = fseek(fp, offset, SEEK_SET) == 0;
+    }
+    
+    for (int b = 0; ok && b < header.blockCount; b++) {
+        const Passenger *rows = records + (size_t)b * ARCHIVE_BLOCK_ROWS;
+        int rowCount = count - b * ARCHIVE_BLOCK_ROWS;
+        if (rowCount > ARCHIVE_BLOCK_ROWS) {
+            rowCount = ARCHIVE_BLOCK_ROWS;
+        }
+        blocks[b].rows = rowCount;
+        
+        for (int c = 0; ok && c < ARCHIVE_COLUMNS; c++) {
+            size_t n = archiveColumn(c, rows, rowCount, raw);
+            size_t stored = archiveCompress(raw, n, packed);
+            const unsigned char *data = packed;
+            if (stored >= n) {
+                data = raw;
+                stored = n;
+            }
+            blocks[b].offset[c] = (unsigned int)offset;
+            blocks[b].length[c] = (unsigned int)stored;
+            blocks[b].rawLength[c] = (unsigned int)n;
+            ok = fwrite(data, 1, stored, fp) == stored;
+            offset += (long)stored;
+        }
+    }
+    
+    if (ok) {
+        rewind(fp);
+        ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(blocks, sizeof(ArchiveBlock), header.blockCount, fp) == (size_t)header.blockCount &&
+             fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    }
+    
+    if (fp && fclose(fp) != 0) {
+        ok = 0;
+    }
+    free(blocks);
+    free(raw);
+    free(packed);
+    if (!ok) {
+        remove(path);
+    }
+    return ok;
+}
+
+/**
+ * Read an archive's header and block directory
+ */
+static int openArchiveReader(ArchiveReader *reader, FILE *fp) {
+    size_t columnMax = (size_t)ARCHIVE_BLOCK_ROWS * (MAX_NAME_LEN + 1);
+    
+    memset(reader, 0, sizeof(ArchiveReader));
+    reader->fp = fp;
+    rewind(fp);
+    if (fread(&reader->header, sizeof(ArchiveHeader), 1, fp) != 1 ||
+        reader->header.magic != ARCHIVE_MAGIC || reader->header.blockCount < 0) {
+        return 0;
+    }
+    
+    reader->blocks = malloc((reader->header.blockCount + 1) * sizeof(ArchiveBlock));
+    reader->raw = malloc(columnMax);
+    reader->packed = malloc(columnMax);
+    reader->rows = malloc(ARCHIVE_BLOCK_ROWS * sizeof(Passenger));
+    return reader->blocks && reader->raw && reader->packed && reader->rows &&
+           fread(reader->blocks, sizeof(ArchiveBlock), reader->header.blockCount, fp) ==
+               (size_t)reader->header.blockCount;
+}
+
+/**
+ * Release the buffers of an archive reader (the file stays open)
+ */
+static void closeArchiveReader(ArchiveReader *reader) {
+    free(reader->blocks);
+    free(reader->raw);
+    free(reader->packed);
+    free(reader->rows);
+    memset(reader, 0, sizeof(ArchiveReader));
+}
+
+/**
+ * Decode the given columns (a bit mask) of one block into reader->rows
+ * Returns the block's row count, or -1 if the archive is damaged
+ */
+static int readArchiveBlock(ArchiveReader *reader, int block, int columns) {
+    size_t columnMax = (size_t)ARCHIVE_BLOCK_ROWS * (MAX_NAME_LEN + 1);
+    const ArchiveBlock *b = &reader->blocks[block];
+    
+    if (b->rows < 0 || b->rows > ARCHIVE_BLOCK_ROWS) {
+        return -1;
+    }
+    memset(reader->rows, 0, b->rows * sizeof(Passenger));
+    
+    for (int c = 0; c < ARCHIVE_COLUMNS; c++) {
+        if (!(columns & (1 << c))) {
+            continue;
+        }
+        if (b->length[c] > columnMax || b->rawLength[c] > columnMax ||
+            fseek(reader->fp, b->offset[c], SEEK_SET) != 0 ||
+            fread(reader->packed, 1, b->length[c], reader->fp) != b->length[c]) {
+            return -1;
+        }
+        
+        const unsigned char *raw = reader->packed;
+        if (b->length[c] != b->rawLength[c]) {
+            if (!archiveDecompress(reader->packed, b->length[c], reader->raw, b->rawLength[c])) {
+                return -1;
+            }
+            raw = reader->raw;
+        }
+        if (!unpackArchiveColumn(c, raw, b->rawLength[c], reader->rows, b->rows)) {
+            return -1;
+        }
+    }
+    
+    for (int i = 0; i < b->rows; i++) {
+        reader->rows[i].flightNumber = reader->header.flightNumber;
+    }
+    return b->rows;
+}
+
+/**
+ * Visit an archive's reservations, decoding only the given columns
+ * Clears *more when visit returns 0; returns the number of records visited,
+ * or -1 if the archive is damaged
+ */
+static long scanArchive(FILE *fp, int columns, int (*visit)(const Passenger *p, void *arg), void *arg,
+                        int *more) {
+    ArchiveReader reader;
+    long visited = 0;
+    
+    if (!openArchiveReader(&reader, fp)) {
+        visited = -1;
+    } else {
+        for (int b = 0; visited >= 0 && *more && b < reader.header.blockCount; b++) {
+            int rows = readArchiveBlock(&reader, b, columns);
+            if (rows < 0) {
+                visited = -1;
+            }
+            for (int i = 0; *more && i < rows; i++) {
+                visited++;
+                *more = visit(&reader.rows[i], arg);
+            }
+        }
+    }
+    closeArchiveReader(&reader);
+    return visited;
+}
+
+/**
+ * Look up an active reservation by PNR in its flight's archive
+ * Returns 1 if found, 0 if not, -1 if the index or archive could not be read
+ */
+static int findArchivedReservation(const char *pnr, Passenger *out) {
+    int flightNumber = findReservationFlight(pnr);
+    FILE *fp = flightNumber < 0 || isFlightArchived(flightNumber) == 0 ? NULL : openArchive(flightNumber);
+    ArchiveReader reader;
+    int found = 0;
+    
+    if (!fp) {
+        return flightNumber == -2 ? -1 : 0;
+    }
+    
+    // Only the PNR and status columns are read until the block is found
+    if (!openArchiveReader(&reader, fp)) {
+        found = -1;
+    } else {
+        for (int b = 0; !found && b < reader.header.blockCount; b++) {
+            int rows = readArchiveBlock(&reader, b, 1 << ARCHIVE_COL_PNR | 1 << ARCHIVE_COL_STATUS);
+            if (rows < 0) {
+                found = -1;
+            }
+            for (int i = 0; i < rows; i++) {
+                if (reader.rows[i].isBooked && strcmp(reader.rows[i].pnr, pnr) == 0) {
+                    found = readArchiveBlock(&reader, b, ARCHIVE_ALL_COLUMNS) > i ? 1 : -1;
+                    if (found > 0) {
+                        *out = reader.rows[i];
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    closeArchiveReader(&reader);
+    fclose(fp);
+    return found;
+}
+
+/**
+ * Record a visited archive row's seat if it is booked
+ */
+static int markArchivedSeat(const Passenger *p, void *arg) {
+    unsigned char *taken = arg;
+    if (p->isBooked && p->seatNumber >= 1 && p->seatNumber <= MAX_SEATS) {
+        taken[p->seatNumber - 1] = 1;
+    }
+    return 1;
+}
+
+/**
+ * Mark the seats booked in a flight's archive (taken[seat - 1] = 1)
+ * Returns 0 if the archive could not be read
+ */
+static int archivedSeatMap(int flightNumber, unsigned char taken[MAX_SEATS]) {
+    if (isFlightArchived(flightNumber) == 0) {
+        return 1;
+    }
+    
+    FILE *fp = openArchive(flightNumber);
+    int more = 1;
+    if (!fp) {
+        return errno == ENOENT;
+    }
+    long visited = scanArchive(fp, 1 << ARCHIVE_COL_SEAT | 1 << ARCHIVE_COL_STATUS, markArchivedSeat, taken, &more);
+    fclose(fp);
+    return visited >= 0;
+}
+
+typedef struct {
+    Passenger *records;
+    int count;
+    int cap;
+} ArchiveRows;
+
+/**
+ * Collect one archived reservation into a growing array
+ */
+static int collectArchiveRow(const Passenger *p, void *arg) {
+    ArchiveRows *rows = arg;
+    if (rows->count == rows->cap) {
+        int newCap = rows->cap ? rows->cap * 2 : ARCHIVE_BLOCK_ROWS;
+        Passenger *grown = realloc(rows->records, newCap * sizeof(Passenger));
+        if (!grown) {
+            return 0;
+        }
+        rows->records = grown;
+        rows->cap = newCap;
+    }
+    rows->records[rows->count++] = *p;
+    return 1;
+}
+
+/**
+ * Move a flight's hot segment into its archive, merging with what is there
+ * Returns the number of reservations moved, or -1 on failure
+ */
+static int archiveFlight(int flightNumber) {
+    char path[64], tempPath[64], hotPath[64];
+    ArchiveRows rows;
+    int more = 1;
+    
+    archivePath(flightNumber, path, sizeof(path));
+    snprintf(tempPath, sizeof(tempPath), "%s/arc_%d.tmp", ARCHIVE_DIR, flightNumber);
+    segmentPath(flightNumber, hotPath, sizeof(hotPath));
+    memset(&rows, 0, sizeof(rows));
+    
+    beginCommit();
+    if (!lockSegment(flightNumber)) {
+        endCommit();
+        return -1;
+    }
+    int hotCount;
+    Passenger *hot = loadSegment(flightNumber, &hotCount);
+    int moved = hotCount;
+    
+    // Nothing is written, and the hot segment stays, unless both tiers were
+    // read in full
+    if (hotCount > 0) {
+        FILE *old = openArchive(flightNumber);
+        if (old) {
+            if (scanArchive(old, ARCHIVE_ALL_COLUMNS, collectArchiveRow, &rows, &more) < 0) {
+                more = 0;
+            }
+            fclose(old);
+        } else if (errno != ENOENT) {
+            more = 0;
+        }
+        for (int i = 0; more && i < hotCount; i++) {
+            more = collectArchiveRow(&hot[i], &rows);
+        }
+        
+        if (!more || (mkdir(ARCHIVE_DIR, 0755) != 0 && errno != EEXIST) ||
+            !writeArchive(tempPath, flightNumber, rows.records, rows.count) ||
+            rename(tempPath, path) != 0) {
+            remove(tempPath);
+            moved = -1;
+        } else {
+            remove(hotPath);
+            Flight flight;
+            memset(&flight, 0, sizeof(flight));
+            flight.flightNumber = flightNumber;
+            logFlightChange(CHANGE_FLIGHT_ARCHIVE, &flight);
+        }
+    }
+    
+    unlockSegment(flightNumber);
+    endCommit();
+    free(hot);
+    free(rows.records);
+    return moved;
+}
+
+/**
+ * Add the archive tier's size and compression to the statistics
+ */
+static void archiveStats(EngineStats *stats) {
+    DIR *dir = opendir(ARCHIVE_DIR);
+    struct dirent *entry;
+    
+    while (dir && (entry = readdir(dir)) != NULL) {
+        int flightNumber;
+        char suffix[8];
+        if (sscanf(entry->d_name, "arc_%d.%7s", &flightNumber, suffix) != 2 || strcmp(suffix, "dat") != 0) {
+            continue;
+        }
+        
+        FILE *fp = openArchive(flightNumber);
+        ArchiveHeader header;
+        struct stat st;
+        if (fp && fread(&header, sizeof(header), 1, fp) == 1 && header.magic == ARCHIVE_MAGIC &&
+            fstat(fileno(fp), &st) == 0) {
+            stats->archivedFlights++;
+            stats->archivedRecords += header.records;
+            stats->archiveBytes += st.st_size;
+            stats->archiveRawBytes += header.rawBytes;
+        }
+        if (fp) {
+            fclose(fp);
+        }
+    }
+    if (dir) {
+        closedir(dir);
+    }
+}
+
+/* ================ SEAT HOLDS ================ */
+
+/*
+ * A seat chosen in bookTicket is held while the passenger enters payment
+ * details. Holds are shared with other sessions through HOLD_FILE, a fixed
+ * size hash table where each (flight, seat) key lives in a small probe
+ * window, so checking a seat never scans the whole file. Stale slots from
+ * crashed sessions are ignored once their expiry time passes.
+ *
+ * Holds placed by this session are also kept on a timer wheel with one
+ * bucket per second. Expiring holds only visits the buckets for the seconds
+ * that elapsed, never the full set of holds in flight.
+ */
+
+static SeatHold holdPool[HOLD_POOL_SIZE];
+static int holdWheel[HOLD_WHEEL_SLOTS];
+static int holdFreeList = -1;
+static time_t holdWheelTime = 0;      // Last second processed by the wheel
+static int holdsInitialized = 0;
+
+/**
+ * Prepare the hold pool free list and empty wheel buckets
+ */
+static void initSeatHolds() {
+    for (int i = 0; i < HOLD_WHEEL_SLOTS; i++) {
+        holdWheel[i] = -1;
+    }
+    for (int i = 0; i < HOLD_POOL_SIZE; i++) {
+        holdPool[i].inUse = 0;
+        holdPool[i].next = (i + 1 < HOLD_POOL_SIZE) ? i + 1 : -1;
+    }
+    holdFreeList = 0;
+    holdWheelTime = time(NULL);
+    holdsInitialized = 1;
+}
+
+/**
+ * Hash a (flight, seat) key to the first slot of its probe window
+ */
+static long holdSlotBase(int flightNumber, int seatNumber) {
+    unsigned int h = (unsigned int)flightNumber * 2654435761u;
+    h ^= (unsigned int)seatNumber * 40503u;
+    h ^= h >> 15;
+    return (long)(h & (HOLD_TABLE_SIZE - 1));
+}
+
+/**
+ * Take or drop an advisory lock on the whole hold file
+ */
+static int lockHoldFile(FILE *fp, short type) {
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    return fcntl(fileno(fp), F_SETLKW, &lock);
+}
+
+/**
+ * Read one probe window; slots past the end of the file count as empty
+ */
+static void readHoldWindow(FILE *fp, long base, SeatHoldSlot *window) {
+    memset(window, 0, sizeof(SeatHoldSlot) * HOLD_PROBE_WINDOW);
+    if (fseek(fp, base * (long)sizeof(SeatHoldSlot), SEEK_SET) == 0) {
+        fread(window, sizeof(SeatHoldSlot), HOLD_PROBE_WINDOW, fp);
+    }
+}
+
+/**
+ * Write a single shared slot back to the hold file
+ */
+static int writeHoldSlot(FILE *fp, long slotIndex, const SeatHoldSlot *slot) {
+    if (fseek(fp, slotIndex * (long)sizeof(SeatHoldSlot), SEEK_SET) != 0) {
+        return 0;
+    }
+    int ok = fwrite(slot, sizeof(SeatHoldSlot), 1, fp) == 1;
+    fflush(fp);
+    return ok;
+}
+
+/**
+ * Unlink a hold from its wheel bucket and return it to the free list
+ */
+static void freeSeatHold(int index) {
+    SeatHold *h = &holdPool[index];
+    
+    if (h->prev != -1) {
+        holdPool[h->prev].next = h->next;
+    } else {
+        holdWheel[h->expiresAt % HOLD_WHEEL_SLOTS] = h->next;
+    }
+    if (h->next != -1) {
+        holdPool[h->next].prev = h->prev;
+    }
+    
+    h->inUse = 0;
+    h->generation++;
+    h->next = holdFreeList;
+    holdFreeList = index;
+}
+
+/**
+ * Clear the shared slot of a hold, unless another session has taken it over
+ */
+static void clearSharedHold(const SeatHold *h) {
+    FILE *fp = fopen(HOLD_FILE, "r+b");
+    if (!fp) {
+        return;
+    }
+    
+    lockHoldFile(fp, F_WRLCK);
+    SeatHoldSlot slot;
+    memset(&slot, 0, sizeof(slot));
+    if (fseek(fp, h->slotIndex * (long)sizeof(SeatHoldSlot), SEEK_SET) == 0 &&
+        fread(&slot, sizeof(SeatHoldSlot), 1, fp) == 1 &&
+        slot.flightNumber == h->flightNumber &&
+        slot.seatNumber == h->seatNumber &&
+        slot.ownerPid == (int)getpid()) {
+        memset(&slot, 0, sizeof(slot));
+        writeHoldSlot(fp, h->slotIndex, &slot);
+    }
+    lockHoldFile(fp, F_UNLCK);
+    fclose(fp);
+}
+
+/**
+ * Release every hold of this session whose time has run out
+ */
+static void expireSeatHolds(time_t now) {
+    if (!holdsInitialized) {
+        initSeatHolds();
+        return;
+    }
+    
+    // Visit only the buckets for the seconds that elapsed; after a long
+    // idle period one full turn of the wheel covers every bucket
+    int ticks = 0;
+    while (holdWheelTime < now && ticks < HOLD_WHEEL_SLOTS) {
+        holdWheelTime++;
+        ticks++;
+        
+        int index = holdWheel[holdWheelTime % HOLD_WHEEL_SLOTS];
+        while (index != -1) {
+            int next = holdPool[index].next;
+            if (holdPool[index].expiresAt <= now) {
+                clearSharedHold(&holdPool[index]);
+                freeSeatHold(index);
+            }
+            index = next;
+        }
+    }
+    holdWheelTime = now;
+}
+
+/**
+ * Check whether another session currently holds a seat
+ */
+static int isSeatHeld(int flightNumber, int seatNumber) {
+    FILE *fp = fopen(HOLD_FILE, "rb");
+    if (!fp) {
+        return 0;  // No hold file means no holds
+    }
+    
+    SeatHoldSlot window[HOLD_PROBE_WINDOW];
+    lockHoldFile(fp, F_RDLCK);
+    readHoldWindow(fp, holdSlotBase(flightNumber, seatNumber), window);
+    lockHoldFile(fp, F_UNLCK);
+    fclose(fp);
+    
+    long long now = (long long)time(NULL);
+    for (int i = 0; i < HOLD_PROBE_WINDOW; i++) {
+        if (window[i].flightNumber == flightNumber &&
+            window[i].seatNumber == seatNumber &&
+            window[i].expiresAt > now &&
+            window[i].ownerPid != (int)getpid()) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Hold a seat for HOLD_TTL_SECONDS, with the fare quoted for it
+ * Returns a hold handle, or -1 if the seat is held elsewhere or no slot is free
+ */
+static int holdSeat(int flightNumber, int seatNumber, float fare) {
+    time_t now = time(NULL);
+    expireSeatHolds(now);
+    
+    if (holdFreeList == -1) {
+        return -1;  // Too many holds in flight for this session
+    }
+    
+    // Created without truncating, in case another session creates it too
+    int fd = open(HOLD_FILE, O_RDWR | O_CREAT, 0644);
+    FILE *fp = fd >= 0 ? fdopen(fd, "r+b") : NULL;
+    if (!fp) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    
+    long base = holdSlotBase(flightNumber, seatNumber);
+    SeatHoldSlot window[HOLD_PROBE_WINDOW];
+    lockHoldFile(fp, F_WRLCK);
+    readHoldWindow(fp, base, window);
+    
+    // Find a live hold for this key, remembering the first reusable slot
+    int freeSlot = -1;
+    int taken = 0;
+    for (int i = 0; i < HOLD_PROBE_WINDOW; i++) {
+        int live = window[i].flightNumber != 0 && window[i].expiresAt > (long long)now;
+        if (live && window[i].flightNumber == flightNumber &&
+            window[i].seatNumber == seatNumber) {
+            if (window[i].ownerPid != (int)getpid()) {
+                taken = 1;
+            } else {
+                freeSlot = i;  // Refresh our own hold in place
+            }
+            break;
+        }
+        if (!live && freeSlot == -1) {
+            freeSlot = i;
+        }
+    }
+    
+    if (taken || freeSlot == -1) {
+        lockHoldFile(fp, F_UNLCK);
+        fclose(fp);
+        return -1;
+    }
+    
+    SeatHoldSlot slot;
+    memset(&slot, 0, sizeof(slot));
+    slot.flightNumber = flightNumber;
+    slot.seatNumber = seatNumber;
+    slot.expiresAt = (long long)now + HOLD_TTL_SECONDS;
+    slot.ownerPid = (int)getpid();
+    
+    int written = writeHoldSlot(fp, base + freeSlot, &slot);
+    lockHoldFile(fp, F_UNLCK);
+    fclose(fp);
+    
+    if (!written) {
+        return -1;
+    }
+    
+    // Track the hold locally on the timer wheel
+    int index = holdFreeList;
+    SeatHold *h = &holdPool[index];
+    holdFreeList = h->next;
+    
+    h->flightNumber = flightNumber;
+    h->seatNumber = seatNumber;
+    h->expiresAt = now + HOLD_TTL_SECONDS;
+    h->fare = fare;
+    h->slotIndex = base + freeSlot;
+    h->inUse = 1;
+    
+    int bucket = h->expiresAt % HOLD_WHEEL_SLOTS;
+    h->prev = -1;
+    h->next = holdWheel[bucket];
+    if (h->next != -1) {
+        holdPool[h->next].prev = index;
+    }
+    holdWheel[bucket] = index;
+    
+    return ((h->generation & 0x7fff) << 16) | index;
+}
+
+/**
+ * Resolve a hold handle to its pool entry, or NULL if it has lapsed
+ */
+static SeatHold *lookupSeatHold(int handle) {
+    if (handle < 0) {
+        return NULL;
+    }
+    
+    expireSeatHolds(time(NULL));
+    
+    int index = handle & 0xffff;
+    SeatHold *h = &holdPool[index];
+    if (!h->inUse || (h->generation & 0x7fff) != (handle >> 16)) {
+        return NULL;
+    }
+    return h;
+}
+
+/**
+ * Check that a hold is still in force for a particular seat
+ */
+static int isSeatHoldFor(int handle, int flightNumber, int seatNumber) {
+    SeatHold *h = lookupSeatHold(handle);
+    return h && h->flightNumber == flightNumber && h->seatNumber == seatNumber;
+}
+
+/**
+ * Release a hold before it expires (booking saved or abandoned)
+ */
+static void releaseSeatHold(int handle) {
+    SeatHold *h = lookupSeatHold(handle);
+    if (!h) {
+        return;
+    }
+    
+    clearSharedHold(h);
+    freeSeatHold(handle & 0xffff);
+}
+
+/**
+ * Release all holds of this session, used on exit
+ */
+static void releaseAllSeatHolds() {
+    if (!holdsInitialized) {
+        return;
+    }
+    
+    for (int i = 0; i < HOLD_WHEEL_SLOTS; i++) {
+        while (holdWheel[i] != -1) {
+            int index = holdWheel[i];
+            clearSharedHold(&holdPool[index]);
+            freeSeatHold(index);
+        }
+    }
+}
+
+/* ================ FLIGHT MANAGEMENT ================ */
+
+/**
+ * Days since 1970-01-01 for a calendar date
+ */
+static long daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long yearOfEra = year - era * 400;
+    long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+/**
+ * Parse a YYYY-MM-DD date into days since 1970-01-01, or -1 if invalid
+ */
+long engineParseFlightDate(const char *date) {
+    int year, month, day;
+    char extra;
+    
+    if (sscanf(date, "%4d-%2d-%2d%c", &year, &month, &day, &extra) != 3 ||
+        year < 1970 || month < 1 || month > 12 || day < 1 || day > 31) {
+        return -1;
+    }
+    return daysFromCivil(year, month, day);
+}
+
+/**
+ * Scheduled departure in minutes since 1970-01-01, or -1 if undated
+ */
+long engineDepartureMinutes(const Flight *flight) {
+    int hours, minutes;
+    long days = engineParseFlightDate(flight->date);
+    
+    if (days < 0 || sscanf(flight->time, "%d:%d", &hours, &minutes) != 2 ||
+        hours < 0 || hours > 23 || minutes < 0 || minutes > 59) {
+        return -1;
+    }
+    return days * 1440 + hours * 60 + minutes;
+}
+
+/*
+ * Fares follow pricing rules with two parts. Load buckets raise the base
+ * fare as seats sell. Booking windows raise it again as departure nears.
+ * The load part is kept on the flight record (fare, fareBucket) and
+ * updated by repriceFlight whenever availableSeats changes. A booking
+ * crosses at most one bucket boundary, so this is O(1). The window part
+ * only depends on the clock and is applied when a fare is quoted. The
+ * quoted fare is copied into the Passenger record, so later price changes
+ * never affect existing bookings.
+ *
+ * Rules are built in and can be replaced by PRICING_RULES_FILE, one rule
+ * per line:
+ *     load <percent sold> <multiplier>
+ *     window <days before departure> <multiplier>
+ * engineReplayPricing runs a rule file against the change log to compare its
+ * revenue with what was actually charged.
+ */
+
+typedef struct {
+    int loadCount;
+    int seatsSold[PRICING_MAX_RULES];         // Ascending; bucket applies from here
+    float loadMultiplier[PRICING_MAX_RULES];
+    int windowCount;
+    int daysBefore[PRICING_MAX_RULES];        // Descending; window applies inside this
+    float windowMultiplier[PRICING_MAX_RULES];
+} PricingRules;
+
+static PricingRules pricingRules = {
+    4, { 0, 50, 75, 90 }, { 1.00f, 1.15f, 1.35f, 1.60f },
+    3, { 21, 7, 2 }, { 1.10f, 1.25f, 1.50f }
+};
+
+/**
+ * Read pricing rules from a file
+ * Returns 1 on success, 0 if the file is missing or malformed
+ */
+static int loadPricingRules(const char *path, PricingRules *rules) {
+    char line[128], kind[16];
+    float value, multiplier;
+    int lineNumber = 0;
+    
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return 0;
+    }
+    
+    memset(rules, 0, sizeof(PricingRules));
+    rules->loadCount = 1;  // Bucket 0 always covers an empty flight
+    rules->loadMultiplier[0] = 1.0f;
+    
+    while (fgets(line, sizeof(line), fp)) {
+        lineNumber++;
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+        if (sscanf(line, "%15s %f %f", kind, &value, &multiplier) != 3 || multiplier <= 0.0f) {
+            engineLog("%s:%d: expected \"load|window <value> <multiplier>\".", path, lineNumber);
+            fclose(fp);
+            return 0;
+        }
+        
+        if (strcmp(kind, "load") == 0 && value >= 0.0f && value <= 100.0f) {
+            int sold = (int)(value * MAX_SEATS / 100.0f + 0.5f);
+            int i = rules->loadCount;
+            if (sold == 0) {
+                rules->loadMultiplier[0] = multiplier;
+                continue;
+            }
+            if (i == PRICING_MAX_RULES || sold <= rules->seatsSold[i - 1]) {
+                engineLog("%s:%d: load rules must ascend, at most %d.", path, lineNumber, PRICING_MAX_RULES);
+                fclose(fp);
+                return 0;
+            }
+            rules->seatsSold[i] = sold;
+            rules->loadMultiplier[i] = multiplier;
+            rules->loadCount++;
+        } else if (strcmp(kind, "window") == 0 && value > 0.0f) {
+            int i = rules->windowCount;
+            if (i == PRICING_MAX_RULES || (i > 0 && (int)value >= rules->daysBefore[i - 1])) {
+                engineLog("%s:%d: window rules must descend, at most %d.", path, lineNumber, PRICING_MAX_RULES);
+                fclose(fp);
+                return 0;
+            }
+            rules->daysBefore[i] = (int)value;
+            rules->windowMultiplier[i] = multiplier;
+            rules->windowCount++;
+        } else {
+            engineLog("%s:%d: unknown rule.", path, lineNumber);
+            fclose(fp);
+            return 0;
+        }
+    }
+    
+    fclose(fp);
+    return 1;
+}
+
+/**
+ * Move a load bucket to match the seats sold
+ * Each call moves only as far as the seat count changed, usually 0 or 1 step
+ */
+static int adjustFareBucket(const PricingRules *rules, int bucket, int sold) {
+    if (bucket < 0 || bucket >= rules->loadCount) {
+        bucket = 0;  // Stale after a rule change
+    }
+    while (bucket + 1 < rules->loadCount && sold >= rules->seatsSold[bucket + 1]) {
+        bucket++;
+    }
+    while (bucket > 0 && sold < rules->seatsSold[bucket]) {
+        bucket--;
+    }
+    return bucket;
+}
+
+/**
+ * Round a price to whole cents
+ */
+static float roundFare(float fare) {
+    return (float)(long)(fare * 100.0f + 0.5f) / 100.0f;
+}
+
+/**
+ * Refresh a flight's load price after its seat count changed
+ */
+static void repriceFlight(Flight *flight) {
+    flight->fareBucket = adjustFareBucket(&pricingRules, flight->fareBucket,
+                                          MAX_SEATS - flight->availableSeats);
+    flight->fare = roundFare(flight->baseFare * pricingRules.loadMultiplier[flight->fareBucket]);
+}
+
+/**
+ * Booking-window multiplier for a departure, given the current time
+ */
+static float windowMultiplier(const PricingRules *rules, long departs, long now) {
+    float multiplier = 1.0f;
+    if (departs < 0) {
+        return multiplier;  // Undated flights only follow load
+    }
+    
+    long minutesLeft = departs - now;
+    for (int i = 0; i < rules->windowCount; i++) {
+        if (minutesLeft < (long)rules->daysBefore[i] * 1440) {
+            multiplier = rules->windowMultiplier[i];
+        }
+    }
+    return multiplier;
+}
+
+/**
+ * Price a seat on a flight right now
+ */
+float engineFlightFare(const Flight *flight) {
+    long now = (long)(time(NULL) / 60);
+    return roundFare(flight->fare * windowMultiplier(&pricingRules, engineDepartureMinutes(flight), now));
+}
+
+typedef struct {
+    int flightNumber;                 // 0 marks an empty slot
+    int availableSeats;
+    float baseFare;
+    long departs;
+    int bucket;                       // Load bucket under the rules being replayed
+} ReplayFlight;
+
+/**
+ * Find or add a flight's slot in the replay table (open addressing)
+ */
+static ReplayFlight *replayFlightSlot(ReplayFlight *table, int size, int flightNumber) {
+    unsigned int slot = ((unsigned int)flightNumber * 2654435761u) & (size - 1);
+    while (table[slot].flightNumber != 0 && table[slot].flightNumber != flightNumber) {
+        slot = (slot + 1) & (size - 1);
+    }
+    return &table[slot];
+}
+
+/**
+ * Replay the change log under a set of pricing rules and compare revenue
+ * Each booking is repriced with the seats sold and time to departure it saw
+ * when it was made. Records seeded from a snapshot have no booking history
+ * and are only counted. Uses the built-in rules if rulesPath is NULL. The
+ * report is written to out.
+ */
+int engineReplayPricing(const char *rulesPath, FILE *out) {
+    PricingRules rules = pricingRules;
+    if (rulesPath && !loadPricingRules(rulesPath, &rules)) {
+        fprintf(out, "Error: Could not load pricing rules from %s.\n", rulesPath);
+        return 0;
+    }
+    
+    char path[EXPORT_PATH_LEN + 32];
+    changeLogPath(changeLogDir, path, sizeof(path));
+    FILE *log = fopen(path, "rb");
+    if (!log) {
+        fprintf(out, "Error: No change log at %s.\n", path);
+        return 0;
+    }
+    
+    int tableSize = 1024, flights = 0;
+    ReplayFlight *table = calloc(tableSize, sizeof(ReplayFlight));
+    ChangeRecord *batch = malloc(CHANGE_LOG_BATCH * sizeof(ChangeRecord));
+    if (!table || !batch) {
+        free(table);
+        free(batch);
+        fclose(log);
+        return 0;
+    }
+    
+    long long records = 0, bookings = 0, carried = 0, cancellations = 0, unknown = 0;
+    long long bucketBookings[PRICING_MAX_RULES] = { 0 };
+    double charged = 0.0, simulated = 0.0;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    
+    size_t count;
+    while ((count = fread(batch, sizeof(ChangeRecord), CHANGE_LOG_BATCH, log)) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            const ChangeRecord *change = &batch[i];
+            records++;
+            
+            if (change->type == CHANGE_FLIGHT_PUT) {
+                if ((flights + 1) * 2 > tableSize) {
+                    // Grow the table before it gets too full to probe quickly
+                    ReplayFlight *grown = calloc(tableSize * 2, sizeof(ReplayFlight));
+                    if (!grown) {
+                        continue;
+                    }
+                    for (int j = 0; j < tableSize; j++) {
+                        if (table[j].flightNumber != 0) {
+                            *replayFlightSlot(grown, tableSize * 2, table[j].flightNumber) = table[j];
+                        }
+                    }
+                    free(table);
+                    table = grown;
+                    tableSize *= 2;
+                }
+                
+                ReplayFlight *f = replayFlightSlot(table, tableSize, change->flight.flightNumber);
+                if (f->flightNumber == 0) {
+                    f->flightNumber = change->flight.flightNumber;
+                    flights++;
+                }
+                f->availableSeats = change->flight.availableSeats;
+                f->baseFare = change->flight.baseFare;
+                f->departs = engineDepartureMinutes(&change->flight);
+                f->bucket = adjustFareBucket(&rules, f->bucket, MAX_SEATS - f->availableSeats);
+            } else if (change->type == CHANGE_RESERVATION_APPEND && change->passenger.isBooked) {
+                if (change->flags & CHANGE_FLAG_SNAPSHOT) {
+                    carried++;
+                    continue;
+                }
+                
+                ReplayFlight *f = replayFlightSlot(table, tableSize, change->passenger.flightNumber);
+                if (f->flightNumber == 0) {
+                    unknown++;
+                    continue;
+                }
+                
+                // The seat count logged before this booking is what it was priced on
+                float fare = f->baseFare * rules.loadMultiplier[f->bucket] *
+                             windowMultiplier(&rules, f->departs, (long)(change->timestamp / 60));
+                simulated += roundFare(fare);
+                charged += change->passenger.fare;
+                bucketBookings[f->bucket]++;
+                bookings++;
+            } else if (change->type == CHANGE_RESERVATION_REPLACE && !change->passenger.isBooked) {
+                cancellations++;
+            }
+        }
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    
+    fprintf(out, "\n=== PRICING REPLAY ===\n");
+    fprintf(out, "Rules: %s\n", rulesPath ? rulesPath : "current");
+    fprintf(out, "Change records replayed: %lld in %.1f ms (%.0f records/s)\n", records,
+            seconds * 1e3, seconds > 0 ? records / seconds : 0.0);
+    fprintf(out, "Flights seen: %d\n", flights);
+    fprintf(out, "Bookings repriced: %lld\n", bookings);
+    if (carried > 0 || unknown > 0) {
+        fprintf(out, "Bookings skipped: %lld from snapshot, %lld for unknown flights\n", carried, unknown);
+    }
+    fprintf(out, "Cancellations: %lld\n", cancellations);
+    fprintf(out, "Revenue charged:     $%.2f\n", charged);
+    fprintf(out, "Revenue under rules: $%.2f", simulated);
+    if (charged > 0.0) {
+        fprintf(out, " (%+.1f%%)", (simulated - charged) * 100.0 / charged);
+    }
+    fprintf(out, "\n");
+    
+    fprintf(out, "Bookings by load bucket:\n");
+    for (int b = 0; b < rules.loadCount; b++) {
+        fprintf(out, "  %3d%%+ sold  x%.2f  %lld\n", rules.seatsSold[b] * 100 / MAX_SEATS,
+                rules.loadMultiplier[b], bucketBookings[b]);
+    }
+    
+    free(table);
+    free(batch);
+    fclose(log);
+    return 1;
+}
+
+/*
+ * The engine keeps flights.dat open together with an in-memory copy of its
+ * records and a hash from flight number to record index. Each access stats
+ * the file first and reloads the copy only if another session replaced or
+ * rewrote it. Updates write the one changed record in place and keep the
+ * copy in step, so the engine never rescans the file for its own changes.
+ */
+
+/**
+ * Remember the identity and modification time of the open flights file
+ */
+static void stampFlightFile(ReservationEngine *engine) {
+    struct stat st;
+    if (fstat(fileno(engine->flightFile), &st) == 0) {
+        engine->flightDevice = st.st_dev;
+        engine->flightInode = st.st_ino;
+        engine->flightModified = st.st_mtim;
+        engine->flightSize = st.st_size;
+    }
+}
+
+/**
+ * Hash slot where a flight number lives or would be inserted
+ */
+static int flightSlot(const ReservationEngine *engine, int flightNumber) {
+    int mask = engine->flightSlotCount - 1;
+    int slot = (int)(((unsigned int)flightNumber * 2654435761u) & mask);
+    while (engine->flightSlots[slot] &&
+           engine->flights[engine->flightSlots[slot] - 1].flightNumber != flightNumber) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * Rebuild the flight-number hash, sized for the current flight count
+ */
+static int indexFlights(ReservationEngine *engine) {
+    int size = 64;
+    while (size < engine->flightCount * 2 + 2) {
+        size *= 2;
+    }
+    
+    int *slots = calloc(size, sizeof(int));
+    if (!slots) {
+        return 0;
+    }
+    free(engine->flightSlots);
+    engine->flightSlots = slots;
+    engine->flightSlotCount = size;
+    
+    for (int i = 0; i < engine->flightCount; i++) {
+        engine->flightSlots[flightSlot(engine, engine->flights[i].flightNumber)] = i + 1;
+    }
+    return 1;
+}
+
+/**
+ * Index of a flight in the in-memory copy, or -1
+ */
+static int flightIndex(const ReservationEngine *engine, int flightNumber) {
+    if (engine->flightSlotCount == 0) {
+        return -1;
+    }
+    return engine->flightSlots[flightSlot(engine, flightNumber)] - 1;
+}
+
+/**
+ * Make room for one more flight in the in-memory copy
+ */
+static int reserveFlight(ReservationEngine *engine) {
+    if (engine->flightCount < engine->flightCap) {
+        return 1;
+    }
+    
+    int newCap = engine->flightCap ? engine->flightCap * 2 : 64;
+    Flight *grown = realloc(engine->flights, newCap * sizeof(Flight));
+    if (!grown) {
+        return 0;
+    }
+    engine->flights = grown;
+    engine->flightCap = newCap;
+    return 1;
+}
+
+/**
+ * Read every record of the open flights file into memory
+ */
+static int readFlights(ReservationEngine *engine) {
+    engine->flightChecked = time(NULL);  // Taken first: writes from now on look newer
+    engine->flightCount = 0;
+    rewind(engine->flightFile);
+    while (reserveFlight(engine) &&
+           fread(&engine->flights[engine->flightCount], sizeof(Flight), 1, engine->flightFile) == 1) {
+        engine->flightCount++;
+    }
+    
+    stampFlightFile(engine);
+    return indexFlights(engine);
+}
+
+/**
+ * (Re)open flights.dat and load every record into memory
+ */
+static int loadFlights(ReservationEngine *engine) {
+    if (engine->flightFile) {
+        fclose(engine->flightFile);
+    }
+    engine->flightFile = fopen(FLIGHT_FILE, "r+b");
+    engine->flightCount = 0;
+    if (!engine->flightFile) {
+        return 0;
+    }
+    return readFlights(engine);
+}
+
+/**
+ * Reload the in-memory flights if flights.dat changed under the engine
+ * Modification times are only as fine as the kernel's clock tick, so two
+ * writes can share one. The copy is trusted only once the file's mtime is
+ * clearly older than the read that produced it; until then, and after any
+ * change, the records are read again from the open file.
+ */
+static int syncFlights(ReservationEngine *engine) {
+    struct stat st;
+    if (!engine->flightFile || stat(FLIGHT_FILE, &st) != 0 ||
+        st.st_dev != engine->flightDevice || st.st_ino != engine->flightInode) {
+        return loadFlights(engine);  // Replaced by a rewrite
+    }
+    if (st.st_size == engine->flightSize &&
+        st.st_mtim.tv_sec == engine->flightModified.tv_sec &&
+        st.st_mtim.tv_nsec == engine->flightModified.tv_nsec &&
+        st.st_mtim.tv_sec + 1 < engine->flightChecked) {
+        return 1;
+    }
+    return readFlights(engine);
+}
+
+/**
+ * Find a flight by number, or NULL
+ */
+static Flight *findFlight(ReservationEngine *engine, int flightNumber) {
+    if (!syncFlights(engine)) {
+        return NULL;
+    }
+    int index = flightIndex(engine, flightNumber);
+    return index < 0 ? NULL : &engine->flights[index];
+}
+
+/**
+ * Write one in-memory flight back to its place in flights.dat
+ */
+static int writeFlight(ReservationEngine *engine, int index) {
+    beginCommit();
+    int ok = fseek(engine->flightFile, (long)index * (long)sizeof(Flight), SEEK_SET) == 0 &&
+             fwrite(&engine->flights[index], sizeof(Flight), 1, engine->flightFile) == 1 &&
+             fflush(engine->flightFile) == 0;
+    if (ok) {
+        stampFlightFile(engine);
+    }
+    endCommit();
+    return ok;
+}
+
+/**
+ * Lock or unlock part of flights.dat (F_WRLCK or F_UNLCK)
+ * A length of 0 runs to the end of the file, however far it grows
+ */
+static void lockFlightRange(ReservationEngine *engine, off_t start, off_t length, short type) {
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    lock.l_start = start;
+    lock.l_len = length;
+    while (fcntl(fileno(engine->flightFile), F_SETLKW, &lock) < 0) {
+        if (errno != EINTR) {
+            return;
+        }
+    }
+}
+
+/**
+ * Lock or unlock one flight's record in flights.dat (F_WRLCK or F_UNLCK)
+ */
+static void lockFlightRecord(ReservationEngine *engine, int index, short type) {
+    lockFlightRange(engine, (off_t)index * (off_t)sizeof(Flight), sizeof(Flight), type);
+}
+
+/**
+ * Check that the open flights file is still the one named flights.dat
+ * removeFlight replaces the file under a whole-file lock; a session that
+ * waited for a lock on the old file must reload rather than write to it
+ */
+static int flightFileCurrent(ReservationEngine *engine) {
+    struct stat named, opened;
+    return stat(FLIGHT_FILE, &named) == 0 && fstat(fileno(engine->flightFile), &opened) == 0 &&
+           named.st_dev == opened.st_dev && named.st_ino == opened.st_ino;
+}
+
+/**
+ * Update available seats for a flight
+ */
+static int updateFlightSeats(ReservationEngine *engine, int flightNumber, int delta) {
+    Flight *flight;
+    int index;
+    
+    // Re-read the record under its lock so no session's seat change is lost
+    while (1) {
+        flight = findFlight(engine, flightNumber);
+        if (!flight) {
+            return 0;
+        }
+        index = (int)(flight - engine->flights);
+        lockFlightRecord(engine, index, F_WRLCK);
+        if (flightFileCurrent(engine)) {
+            break;
+        }
+        lockFlightRecord(engine, index, F_UNLCK);  // findFlight reloads the new file
+    }
+    if (fseek(engine->flightFile, (long)index * (long)sizeof(Flight), SEEK_SET) != 0 ||
+        fread(flight, sizeof(Flight), 1, engine->flightFile) != 1 ||
+        flight->flightNumber != flightNumber) {
+        lockFlightRecord(engine, index, F_UNLCK);
+        loadFlights(engine);  // Rewritten meanwhile
+        return 0;
+    }
+    
+    // Ensure seat count stays within valid range
+    int newSeats = flight->availableSeats + delta;
+    if (newSeats < 0 || newSeats > MAX_SEATS) {
+        lockFlightRecord(engine, index, F_UNLCK);
+        return 0;
+    }
+    
+    flight->availableSeats = newSeats;
+    repriceFlight(flight);
+    int ok = writeFlight(engine, index);
+    if (ok) {
+        // Logged before the lock is released, so records carrying the full
+        // flight state reach the log in the order they were applied
+        logFlightChange(CHANGE_FLIGHT_PUT, flight);
+    }
+    lockFlightRecord(engine, index, F_UNLCK);
+    return ok;
+}
+
+/**
+ * Append new flight records to flights.dat
+ * Written through the engine's open file: opening and closing another
+ * descriptor on flights.dat would drop this process's record locks. Sessions
+ * adding flights take turns through a lock on everything past the current
+ * end, which does not wait for seat updates on existing records.
+ * Flight numbers are checked once the lock is held: a flight whose number is
+ * in the file by then is not written, and its entry in taken is set, if given
+ * Returns the number of flights written, or -1 if they could not be written
+ */
+static int appendFlights(ReservationEngine *engine, const Flight *flights, int count,
+                         unsigned char *taken) {
+    struct stat st;
+    off_t end;
+    
+    while (1) {
+        if (!syncFlights(engine) || fstat(fileno(engine->flightFile), &st) != 0) {
+            return -1;
+        }
+        end = st.st_size;
+        lockFlightRange(engine, end, 0, F_WRLCK);
+        if (flightFileCurrent(engine)) {
+            break;
+        }
+        lockFlightRange(engine, end, 0, F_UNLCK);  // syncFlights reloads the new file
+    }
+    
+    // Sessions that appended before the lock was granted are seen from here on
+    if (!syncFlights(engine)) {
+        lockFlightRange(engine, end, 0, F_UNLCK);
+        return -1;
+    }
+    
+    beginCommit();
+    int written = 0;
+    int ok = fseek(engine->flightFile, 0, SEEK_END) == 0;
+    for (int i = 0; ok && i < count; i++) {
+        int exists = flightIndex(engine, flights[i].flightNumber) >= 0;
+        if (taken) {
+            taken[i] = (unsigned char)exists;
+        }
+        if (!exists) {
+            ok = fwrite(&flights[i], sizeof(Flight), 1, engine->flightFile) == 1;
+            written++;
+        }
+    }
+    ok = ok && fflush(engine->flightFile) == 0;
+    endCommit();
+    lockFlightRange(engine, end, 0, F_UNLCK);
+    return readFlights(engine) && ok ? written : -1;
+}
+
+/**
+ * Insert or overwrite a flight record by flight number
+ */
+static int putFlight(ReservationEngine *engine, const Flight *flight) {
+    if (!syncFlights(engine)) {
+        return 0;
+    }
+    
+    int index = flightIndex(engine, flight->flightNumber);
+    if (index >= 0) {
+        engine->flights[index] = *flight;
+        return writeFlight(engine, index);
+    }
+    return appendFlights(engine, flight, 1, NULL) == 1;
+}
+
+/**
+ * Remove a flight record by flight number, returning the removed record
+ */
+static int removeFlight(ReservationEngine *engine, int flightNumber, Flight *removed) {
+    // The whole file stays locked from the copy to the rename, so no seat
+    // update or append lands in the old file after it was copied
+    while (1) {
+        if (!syncFlights(engine)) {
+            return 0;
+        }
+        lockFlightRange(engine, 0, 0, F_WRLCK);
+        if (flightFileCurrent(engine)) {
+            break;
+        }
+        lockFlightRange(engine, 0, 0, F_UNLCK);  // syncFlights reloads the new file
+    }
+    
+    // Re-read under the lock to copy what other sessions wrote before it
+    int index = readFlights(engine) ? flightIndex(engine, flightNumber) : -1;
+    FILE *temp = index < 0 ? NULL : fopen(TEMP_FILE, "wb");
+    if (!temp) {
+        lockFlightRange(engine, 0, 0, F_UNLCK);
+        return 0;
+    }
+    for (int i = 0; i < engine->flightCount; i++) {
+        if (i != index) {
+            fwrite(&engine->flights[i], sizeof(Flight), 1, temp);
+        }
+    }
+    if (fclose(temp) != 0) {
+        remove(TEMP_FILE);
+        lockFlightRange(engine, 0, 0, F_UNLCK);
+        return 0;
+    }
+    
+    if (removed) {
+        *removed = engine->flights[index];
+    }
+    beginCommit();
+    int ok = rename(TEMP_FILE, FLIGHT_FILE) == 0;
+    endCommit();
+    if (!ok) {
+        remove(TEMP_FILE);
+        lockFlightRange(engine, 0, 0, F_UNLCK);
+        return 0;
+    }
+    loadFlights(engine);  // Closing the replaced file releases its lock
+    return 1;
+}
+
+/**
+ * Check whether a seat on a specific flight can be booked
+ * Returns ENGINE_OK, ENGINE_INVALID, ENGINE_ARCHIVED, ENGINE_SEAT_HELD,
+ * ENGINE_SEAT_TAKEN, or ENGINE_ERROR if the flight's reservations could not
+ * be read
+ */
+static int seatStatus(int flightNumber, int seatNum) {
+    if (seatNum < 1 || seatNum > MAX_SEATS) {
+        return ENGINE_INVALID;
+    }
+    
+    // A departed flight's seats are settled in its archive; it takes no
+    // new bookings, and flights never archived need no archive read
+    int archived = isFlightArchived(flightNumber);
+    if (archived != 0) {
+        return archived > 0 ? ENGINE_ARCHIVED : ENGINE_ERROR;
+    }
+    
+    if (isSeatHeld(flightNumber, seatNum)) {
+        return ENGINE_SEAT_HELD;  // Another booking is in progress for this seat
+    }
+    
+    int count;
+    Passenger *records = loadSegment(flightNumber, &count);
+    if (count < 0) {
+        return ENGINE_ERROR;
+    }
+    
+    // An empty or missing segment means all seats are available
+    int status = ENGINE_OK;
+    for (int i = 0; i < count; i++) {
+        if (records[i].seatNumber == seatNum && records[i].isBooked) {
+            status = ENGINE_SEAT_TAKEN;
+            break;
+        }
+    }
+    free(records);
+    return status;
+}
+
+/**
+ * Check if a seat is available on a specific flight
+ * A seat whose flight cannot be read is not available
+ */
+static int isSeatAvailable(int flightNumber, int seatNum) {
+    return seatStatus(flightNumber, seatNum) == ENGINE_OK;
+}
+
+/**
+ * Append a new booking once its seat is confirmed free under the segment lock
+ * The check callers make beforehand can race another session booking the
+ * same seat; this one cannot
+ * Returns ENGINE_OK or the seatStatus or ENGINE_ERROR that stopped it
+ */
+static int appendBooking(const Passenger *p) {
+    beginCommit();
+    if (!lockSegment(p->flightNumber)) {
+        endCommit();
+        return ENGINE_ERROR;
+    }
+    int status = seatStatus(p->flightNumber, p->seatNumber);
+    if (status == ENGINE_OK && !appendReservationLocked(p)) {
+        status = ENGINE_ERROR;
+    }
+    unlockSegment(p->flightNumber);
+    endCommit();
+    return status;
+}
+
+/**
+ * Move a booking to another seat on its flight once the seat is confirmed
+ * free under the segment lock
+ * Returns ENGINE_OK, ENGINE_NOT_FOUND, ENGINE_ERROR or the seatStatus that stopped it
+ */
+static int replaceBookingSeat(const char *pnr, const Passenger *replacement) {
+    beginCommit();
+    if (!lockSegment(replacement->flightNumber)) {
+        endCommit();
+        return ENGINE_ERROR;
+    }
+    int status = seatStatus(replacement->flightNumber, replacement->seatNumber);
+    if (status == ENGINE_OK) {
+        int replaced = replaceReservationLocked(replacement->flightNumber, pnr, replacement);
+        status = replaced > 0 ? ENGINE_OK : replaced == 0 ? ENGINE_NOT_FOUND : ENGINE_ERROR;
+    }
+    unlockSegment(replacement->flightNumber);
+    endCommit();
+    return status;
+}
+
+/* ================ SNAPSHOTS ================ */
+
+/*
+ * Listings, reports and exports read a snapshot instead of the live files,
+ * so a long scan sees one point in time and never holds a lock while it
+ * runs. Segments only grow by appends, and rewrites build a new file that
+ * is renamed over the old one, so an open segment plus its length at
+ * capture time pins its contents: later appends land past that length and
+ * a rewrite leaves the captured file untouched. Flights are few and are
+ * copied. Capture holds COMMIT_LOCK_FILE exclusively only while it opens
+ * the segments, which costs one open per flight, not a read of the data.
+ * Archives never change once written, so they are pinned the same way.
+ */
+
+/**
+ * Change log position the current state reflects
+ */
+static long long currentSequence(const ReservationEngine *engine) {
+    char path[EXPORT_PATH_LEN + 32];
+    struct stat st;
+    
+    if (engine->readOnly) {
+        return replicaApplied;
+    }
+    changeLogPath(changeLogDir, path, sizeof(path));
+    return stat(path, &st) == 0 ? st.st_size / (off_t)sizeof(ChangeRecord) : 0;
+}
+
+/**
+ * Add an open segment to a snapshot, pinned at its current length
+ */
+static int addSnapshotSegment(EngineSnapshot *snapshot, int *cap, int flightNumber, FILE *fp) {
+    struct stat st;
+    
+    if (snapshot->segmentCount == *cap) {
+        int newCap = *cap ? *cap * 2 : 16;
+        SnapshotSegment *grown = realloc(snapshot->segments, newCap * sizeof(SnapshotSegment));
+        if (!grown) {
+            return 0;
+        }
+        snapshot->segments = grown;
+        *cap = newCap;
+    }
+    if (fstat(fileno(fp), &st) != 0) {
+        return 0;
+    }
+    
+    SnapshotSegment *seg = &snapshot->segments[snapshot->segmentCount++];
+    seg->flightNumber = flightNumber;
+    seg->fp = fp;
+    seg->records = (long)(st.st_size / (off_t)sizeof(Passenger));  // Whole records only
+    return 1;
+}
+
+/**
+ * Add an open archive to a snapshot
+ */
+static int addSnapshotArchive(EngineSnapshot *snapshot, int *cap, int flightNumber, FILE *fp) {
+    ArchiveHeader header;
+    
+    if (snapshot->archiveCount == *cap) {
+        int newCap = *cap ? *cap * 2 : 16;
+        SnapshotSegment *grown = realloc(snapshot->archives, newCap * sizeof(SnapshotSegment));
+        if (!grown) {
+            return 0;
+        }
+        snapshot->archives = grown;
+        *cap = newCap;
+    }
+    if (fread(&header, sizeof(header), 1, fp) != 1 || header.magic != ARCHIVE_MAGIC) {
+        return 0;
+    }
+    
+    SnapshotSegment *seg = &snapshot->archives[snapshot->archiveCount++];
+    seg->flightNumber = flightNumber;
+    seg->fp = fp;
+    seg->records = header.records;
+    return 1;
+}
+
+/**
+ * Capture flights and segments; flightNumber limits it to one segment (0 = all)
+ */
+static int takeSnapshot(ReservationEngine *engine, EngineSnapshot *snapshot, int flightNumber) {
+    memset(snapshot, 0, sizeof(EngineSnapshot));
+    
+    // Our own commits cannot be in progress here, so only lock against others
+    int locked = commitDepth == 0 && lockCommitFile(F_WRLCK);
+    int ok = syncFlights(engine);
+    int cap = 0;
+    
+    if (ok) {
+        snapshot->flights = malloc((engine->flightCount + 1) * sizeof(Flight));
+        ok = snapshot->flights != NULL;
+    }
+    if (ok) {
+        memcpy(snapshot->flights, engine->flights, engine->flightCount * sizeof(Flight));
+        snapshot->flightCount = engine->flightCount;
+    }
+    
+    FILE *fp;
+    if (ok && flightNumber != 0) {
+        fp = openSegment(flightNumber, "rb");
+        if (fp && !addSnapshotSegment(snapshot, &cap, flightNumber, fp)) {
+            fclose(fp);
+            ok = 0;
+        }
+    } else if (ok) {
+        DIR *dir = opendir(SEGMENT_DIR);
+        int segmentFlight;
+        while (ok && (fp = openNextSegment(dir, &segmentFlight)) != NULL) {
+            if (!addSnapshotSegment(snapshot, &cap, segmentFlight, fp)) {
+                fclose(fp);
+                ok = 0;
+            }
+        }
+        if (dir) {
+            closedir(dir);
+        }
+    }
+    
+    int archiveCap = 0;
+    if (ok && flightNumber != 0) {
+        fp = openArchive(flightNumber);
+        if (fp && !addSnapshotArchive(snapshot, &archiveCap, flightNumber, fp)) {
+            fclose(fp);
+            ok = 0;
+        }
+    } else if (ok) {
+        DIR *dir = opendir(ARCHIVE_DIR);
+        struct dirent *entry;
+        int archivedFlight;
+        char suffix[8];
+        while (ok && dir && (entry = readdir(dir)) != NULL) {
+            if (sscanf(entry->d_name, "arc_%d.%7s", &archivedFlight, suffix) != 2 ||
+                strcmp(suffix, "dat") != 0 || (fp = openArchive(archivedFlight)) == NULL) {
+                continue;
+            }
+            if (!addSnapshotArchive(snapshot, &archiveCap, archivedFlight, fp)) {
+                fclose(fp);
+                ok = 0;
+            }
+        }
+        if (dir) {
+            closedir(dir);
+        }
+    }
+    
+    snapshot->sequence = currentSequence(engine);
+    snapshot->takenAt = time(NULL);
+    if (locked) {
+        lockCommitFile(F_UNLCK);
+    }
+    
+    if (!ok) {
+        engineCloseSnapshot(snapshot);
+        return ENGINE_ERROR;
+    }
+    return ENGINE_OK;
+}
+
+/**
+ * Take a consistent point-in-time view of every flight and reservation
+ */
+int engineOpenSnapshot(ReservationEngine *engine, EngineSnapshot *snapshot) {
+    return takeSnapshot(engine, snapshot, 0);
+}
+
+/**
+ * Visit a snapshot's records; only the given archive columns are decoded
+ * Returns the number visited, or -1 if a segment or archive could not be read
+ */
+static long scanSnapshotColumns(const EngineSnapshot *snapshot, int columns,
+                                int (*visit)(const Passenger *p, void *arg), void *arg) {
+    Passenger chunk[SNAPSHOT_READ_CHUNK];
+    long visited = 0;
+    int more = 1;
+    
+    for (int s = 0; more && s < snapshot->segmentCount; s++) {
+        const SnapshotSegment *seg = &snapshot->segments[s];
+        long remaining = seg->records;
+        
+        rewind(seg->fp);
+        while (more && remaining > 0) {
+            size_t want = remaining < SNAPSHOT_READ_CHUNK ? (size_t)remaining : SNAPSHOT_READ_CHUNK;
+            size_t n = fread(chunk, sizeof(Passenger), want, seg->fp);
+            if (n == 0) {
+                return -1;  // The file held these records when the snapshot was taken
+            }
+            remaining -= (long)n;
+            for (size_t i = 0; more && i < n; i++) {
+                visited++;
+                more = visit(&chunk[i], arg);
+            }
+        }
+    }
+    
+    for (int a = 0; more && a < snapshot->archiveCount; a++) {
+        long archived = scanArchive(snapshot->archives[a].fp, columns, visit, arg, &more);
+        if (archived < 0) {
+            return -1;
+        }
+        visited += archived;
+    }
+    return visited;
+}
+
+/**
+ * Visit every reservation record in a snapshot, segment by segment,
+ * then the archived flights
+ * Stops early when visit returns 0; returns the number of records visited,
+ * or -1 if a segment or archive could not be read
+ */
+long engineScanSnapshot(const EngineSnapshot *snapshot,
+                        int (*visit)(const Passenger *p, void *arg), void *arg) {
+    return scanSnapshotColumns(snapshot, ARCHIVE_ALL_COLUMNS, visit, arg);
+}
+
+/**
+ * Release the files and memory held by a snapshot
+ */
+void engineCloseSnapshot(EngineSnapshot *snapshot) {
+    for (int s = 0; s < snapshot->segmentCount; s++) {
+        fclose(snapshot->segments[s].fp);
+    }
+    for (int a = 0; a < snapshot->archiveCount; a++) {
+        fclose(snapshot->archives[a].fp);
+    }
+    free(snapshot->segments);
+    free(snapshot->archives);
+    free(snapshot->flights);
+    memset(snapshot, 0, sizeof(EngineSnapshot));
+}
+
+/* ================ DATA EXPORT AND IMPORT ================ */
+
+/*
+ * Export streams reservations and flights to CSV or NDJSON one record at a
+ * time through a large output buffer, so memory use does not depend on the
+ * size of the data. Reservations are read from a snapshot, so an export
+ * is consistent even while bookings continue. Import reads one line at a time, validates it and
+ * appends it through a small set of buffered segment files. The state it
+ * keeps is bounded by the number of flights, never by the number of rows.
+ *
+ * A flight schedule is loaded as one batch instead of one addFlight per row,
+ * each of which would check flights.dat for the number first. The valid rows
+ * are sorted by flight number, so repeats within the file sit next to each
+ * other, and then merged against the current flight numbers, also sorted:
+ * O(n log n) for the whole file. Accepted flights go to flights.dat in one
+ * buffered append.
+ */
+
+typedef struct {
+    Flight flight;
+    long line;                        // Line in the schedule file
+} ScheduleRow;
+
+typedef struct {
+    long line;
+    const char *reason;
+} ScheduleReject;
+
+typedef struct {
+    int flightNumber;
+    FILE *fp;
+    unsigned char seats[MAX_SEATS];   // 1 = seat already booked
+    int booked;                       // Booked rows in the current batch
+    int seriesHour;                   // Time series bucket being collected
+    int seriesBooked;
+    int seriesCancelled;
+} ImportSegment;
+
+typedef struct {
+    FILE *out;
+    int format;
+    const ExportFilter *filter;
+    long rows;
+} ExportContext;
+
+/**
+ * Booking date encoded in a PNR prefix as YYMMDD, or 0 if malformed
+ */
+static int pnrBookingDate(const char *pnr) {
+    for (int i = 0; i < 6; i++) {
+        if (!isdigit((unsigned char)pnr[i])) {
+            return 0;
+        }
+    }
+    return (pnr[0] - '0') * 100000 + (pnr[1] - '0') * 10000 + (pnr[2] - '0') * 1000 +
+           (pnr[3] - '0') * 100 + (pnr[4] - '0') * 10 + (pnr[5] - '0');
+}
+
+/**
+ * Start of the booking day encoded in a PNR, or 0 if it has none
+ */
+static time_t pnrBookingTime(const char *pnr) {
+    int date = pnrBookingDate(pnr);
+    if (date == 0) {
+        return 0;
+    }
+    return (time_t)daysFromCivil(2000 + date / 10000, date / 100 % 100, date % 100) * 86400;
+}
+
+/**
+ * Parse a YYYY-MM-DD date into YYMMDD form
+ * Returns 0 for a blank date (open range) or -1 if it is not a valid date
+ */
+int engineParseExportDate(const char *text) {
+    int year, month, day;
+    if (text[0] == '\0') {
+        return 0;
+    }
+    if (engineParseFlightDate(text) < 0 || sscanf(text, "%d-%d-%d", &year, &month, &day) != 3) {
+        return -1;
+    }
+    return (year % 100) * 10000 + month * 100 + day;
+}
+
+/**
+ * Write a CSV field, quoting it when it contains separators or quotes
+ */
+static void csvWriteString(FILE *out, const char *s) {
+    if (strpbrk(s, ",\"\r\n") == NULL) {
+        fputs(s, out);
+        return;
+    }
+    
+    fputc('"', out);
+    for (; *s; s++) {
+        if (*s == '"') {
+            fputc('"', out);
+        }
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+/**
+ * Write a JSON string literal with the required escapes
+ */
+static void jsonWriteString(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fputc('\\', out);
+            fputc(c, out);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/**
+ * Check a reservation against the export filters
+ */
+static int matchesExportFilter(const Passenger *p, const ExportFilter *filter) {
+    if (filter->flightNumber != 0 && p->flightNumber != filter->flightNumber) {
+        return 0;
+    }
+    if ((filter->status == EXPORT_STATUS_ACTIVE && !p->isBooked) ||
+        (filter->status == EXPORT_STATUS_CANCELLED && p->isBooked)) {
+        return 0;
+    }
+    
+    int date = pnrBookingDate(p->pnr);
+    if ((filter->fromDate && date < filter->fromDate) ||
+        (filter->toDate && date > filter->toDate)) {
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Write one reservation as a CSV row or NDJSON object
+ */
+static void writeReservationRecord(FILE *out, int format, const Passenger *p) {
+    int date = pnrBookingDate(p->pnr);
+    char bookingDate[24] = "";
+    if (date) {
+        snprintf(bookingDate, sizeof(bookingDate), "20%02d-%02d-%02d",
+                 date / 10000, date / 100 % 100, date % 100);
+    }
+    
+    if (format == EXPORT_FORMAT_CSV) {
+        csvWriteString(out, p->pnr);
+        fputc(',', out);
+        csvWriteString(out, p->name);
+        fprintf(out, ",%d,%c,%d,%d,%.2f,%d,%s,%s\n", p->age, p->gender, p->seatNumber,
+                p->flightNumber, p->fare, p->paymentMethod,
+                p->isBooked ? "booked" : "cancelled", bookingDate);
+    } else {
+        fputs("{\"pnr\":", out);
+        jsonWriteString(out, p->pnr);
+        fputs(",\"name\":", out);
+        jsonWriteString(out, p->name);
+        fprintf(out, ",\"age\":%d,\"gender\":\"%c\",\"seat\":%d,\"flight\":%d,"
+                "\"fare\":%.2f,\"payment_method\":%d,\"status\":\"%s\","
+                "\"booking_date\":\"%s\"}\n",
+                p->age, p->gender, p->seatNumber, p->flightNumber, p->fare,
+                p->paymentMethod, p->isBooked ? "booked" : "cancelled", bookingDate);
+    }
+}
+
+/**
+ * Write one snapshot record to the export if it matches the filter
+ */
+static int exportRecord(const Passenger *p, void *arg) {
+    ExportContext *export = arg;
+    if (matchesExportFilter(p, export->filter)) {
+        writeReservationRecord(export->out, export->format, p);
+        export->rows++;
+    }
+    return 1;
+}
+
+/**
+ * Export reservations matching a filter
+ * Returns the number of rows written, or -1 if the output could not be written
+ */
+long engineExportReservations(ReservationEngine *engine, const char *path, int format,
+                              const ExportFilter *filter) {
+    EngineSnapshot snapshot;
+    
+    if (filter->fromDate < 0 || filter->toDate < 0) {
+        return -1;  // Invalid date from engineParseExportDate
+    }
+    
+    // A single flight only needs its own segment
+    if (takeSnapshot(engine, &snapshot, filter->flightNumber) != ENGINE_OK) {
+        return -1;
+    }
+    
+    ExportContext export = { fopen(path, "w"), format, filter, 0 };
+    if (!export.out) {
+        engineCloseSnapshot(&snapshot);
+        return -1;
+    }
+    setvbuf(export.out, NULL, _IOFBF, EXPORT_BUFFER_SIZE);
+    
+    if (format == EXPORT_FORMAT_CSV) {
+        fputs("pnr,name,age,gender,seat,flight,fare,payment_method,status,booking_date\n", export.out);
+    }
+    long scanned = engineScanSnapshot(&snapshot, exportRecord, &export);
+    engineCloseSnapshot(&snapshot);
+    
+    if (fclose(export.out) != 0 || scanned < 0) {
+        return -1;
+    }
+    return export.rows;
+}
+
+/**
+ * Export the flight table
+ * Returns the number of rows written, or -1 if the output could not be written
+ */
+long engineExportFlights(ReservationEngine *engine, const char *path, int format) {
+    if (!syncFlights(engine)) {
+        return -1;
+    }
+    
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        return -1;
+    }
+    setvbuf(out, NULL, _IOFBF, EXPORT_BUFFER_SIZE);
+    
+    if (format == EXPORT_FORMAT_CSV) {
+        fputs("flight,departure,destination,date,time,duration_minutes,base_fare,fare,available_seats\n", out);
+    }
+    
+    long rows = 0;
+    for (int i = 0; i < engine->flightCount; i++) {
+        const Flight flight = engine->flights[i];
+        if (format == EXPORT_FORMAT_CSV) {
+            fprintf(out, "%d,", flight.flightNumber);
+            csvWriteString(out, flight.departure);
+            fputc(',', out);
+            csvWriteString(out, flight.destination);
+            fprintf(out, ",%s,", flight.date);
+            csvWriteString(out, flight.time);
+            fprintf(out, ",%d,%.2f,%.2f,%d\n", flight.durationMinutes, flight.baseFare,
+                    flight.fare, flight.availableSeats);
+        } else {
+            fprintf(out, "{\"flight\":%d,\"departure\":", flight.flightNumber);
+            jsonWriteString(out, flight.departure);
+            fputs(",\"destination\":", out);
+            jsonWriteString(out, flight.destination);
+            fprintf(out, ",\"date\":\"%s\",\"time\":", flight.date);
+            jsonWriteString(out, flight.time);
+            fprintf(out, ",\"duration_minutes\":%d,\"base_fare\":%.2f,\"fare\":%.2f,"
+                    "\"available_seats\":%d}\n",
+                    flight.durationMinutes, flight.baseFare, flight.fare, flight.availableSeats);
+        }
+        rows++;
+    }
+    
+    if (fclose(out) != 0) {
+        return -1;
+    }
+    return rows;
+}
+
+/**
+ * Split a CSV line in place, honouring quoted fields
+ * Returns the number of fields, or -1 on a malformed quote
+ */
+static int splitCsvLine(char *line, char **fields, int maxFields) {
+    int count = 0;
+    char *src = line;
+    
+    while (count < maxFields) {
+        char *dst = src;
+        fields[count++] = dst;
+        
+        if (*src == '"') {
+            src++;
+            while (1) {
+                if (*src == '\0') {
+                    return -1;  // Unterminated quote
+                }
+                if (*src == '"') {
+                    if (src[1] != '"') {
+                        src++;
+                        break;
+                    }
+                    src++;  // Escaped quote
+                }
+                *dst++ = *src++;
+            }
+        } else {
+            while (*src && *src != ',') {
+                *dst++ = *src++;
+            }
+        }
+        
+        if (*src == ',') {
+            *dst = '\0';
+            src++;
+            continue;
+        }
+        if (*src != '\0') {
+            return -1;  // Text after a closing quote
+        }
+        *dst = '\0';
+        return count;
+    }
+    return count;
+}
+
+/**
+ * Parse a JSON string literal starting at the opening quote
+ * Returns a pointer past the closing quote, or NULL if malformed
+ */
+static const char *jsonParseString(const char *s, char *out, size_t size) {
+    size_t len = 0;
+    
+    if (*s++ != '"') {
+        return NULL;
+    }
+    while (*s && *s != '"') {
+        char c = *s++;
+        if (c == '\\') {
+            c = *s++;
+            if (c == 'u') {
+                unsigned code;
+                if (sscanf(s, "%4x", &code) != 1) {
+                    return NULL;
+                }
+                s += 4;
+                c = code < 0x80 ? (char)code : '?';
+            } else if (c == 'n') {
+                c = '\n';
+            } else if (c == 't') {
+                c = '\t';
+            } else if (c != '"' && c != '\\' && c != '/') {
+                return NULL;
+            }
+        }
+        if (len + 1 >= size) {
+            return NULL;  // Value too long for the field
+        }
+        out[len++] = c;
+    }
+    if (*s != '"') {
+        return NULL;
+    }
+    out[len] = '\0';
+    return s + 1;
+}
+
+static const char *reservationImportKeys[IMPORT_FIELDS] = {
+    "pnr", "name", "age", "gender", "seat", "flight", "fare", "payment_method", "status"
+};
+static const char *scheduleImportKeys[SCHEDULE_FIELDS] = {
+    "flight", "departure", "destination", "date", "time", "duration_minutes", "base_fare"
+};
+
+/**
+ * Parse one flat NDJSON object into CSV-style field strings, in keys order
+ * Returns the number of known keys found, or -1 if malformed
+ */
+static int parseJsonLine(const char *s, const char **keys, int keyCount,
+                         char fields[][IMPORT_FIELD_LEN]) {
+    int found = 0;
+    
+    while (isspace((unsigned char)*s)) s++;
+    if (*s++ != '{') {
+        return -1;
+    }
+    
+    while (1) {
+        char key[32], value[IMPORT_FIELD_LEN];
+        
+        while (isspace((unsigned char)*s)) s++;
+        if (*s == '}') {
+            return found;
+        }
+        if (!(s = jsonParseString(s, key, sizeof(key)))) {
+            return -1;
+        }
+        while (isspace((unsigned char)*s)) s++;
+        if (*s++ != ':') {
+            return -1;
+        }
+        while (isspace((unsigned char)*s)) s++;
+        
+        if (*s == '"') {
+            if (!(s = jsonParseString(s, value, sizeof(value)))) {
+                return -1;
+            }
+        } else {
+            size_t len = 0;
+            while (*s && *s != ',' && *s != '}' && !isspace((unsigned char)*s)) {
+                if (len + 1 >= sizeof(value)) {
+                    return -1;
+                }
+                value[len++] = *s++;
+            }
+            value[len] = '\0';
+        }
+        
+        for (int i = 0; i < keyCount; i++) {
+            if (strcmp(key, keys[i]) == 0) {
+                strcpy(fields[i], value);
+                found++;
+                break;
+            }
+        }
+        
+        while (isspace((unsigned char)*s)) s++;
+        if (*s == ',') {
+            s++;
+        } else if (*s != '}') {
+            return -1;
+        }
+    }
+}
+
+/**
+ * Split one CSV or NDJSON import line into fieldCount field strings
+ * CSV columns past fieldCount are ignored; NDJSON lines must have every key
+ * Returns NULL on success or a short reason for rejecting the row
+ */
+static const char *splitImportLine(char *line, const char **keys, int fieldCount,
+                                   char fields[][IMPORT_FIELD_LEN]) {
+    memset(fields, 0, (size_t)fieldCount * IMPORT_FIELD_LEN);
+    if (line[0] == '{') {
+        if (parseJsonLine(line, keys, fieldCount, fields) != fieldCount) {
+            return "malformed JSON or missing fields";
+        }
+        return NULL;
+    }
+    
+    char *parts[IMPORT_FIELDS + 1];
+    int n = splitCsvLine(line, parts, fieldCount + 1);
+    if (n < fieldCount) {
+        return "malformed CSV or missing fields";
+    }
+    for (int i = 0; i < fieldCount; i++) {
+        if (strlen(parts[i]) >= IMPORT_FIELD_LEN) {
+            return "field too long";
+        }
+        strcpy(fields[i], parts[i]);
+    }
+    return NULL;
+}
+
+/**
+ * Validate import fields and build a reservation
+ * Returns NULL on success or a short reason for rejecting the row
+ */
+static const char *buildImportedReservation(char fields[][IMPORT_FIELD_LEN], Passenger *p) {
+    char *end;
+    
+    memset(p, 0, sizeof(Passenger));
+    
+    size_t pnrLen = strlen(fields[0]);
+    if (pnrLen == 0 || pnrLen > PNR_LEN) {
+        return "invalid PNR";
+    }
+    for (size_t i = 0; i < pnrLen; i++) {
+        if (!isalnum((unsigned char)fields[0][i])) {
+            return "invalid PNR";
+        }
+    }
+    strcpy(p->pnr, fields[0]);
+    
+    if (fields[1][0] == '\0' || strlen(fields[1]) > MAX_NAME_LEN) {
+        return "invalid name";
+    }
+    strcpy(p->name, fields[1]);
+    
+    p->age = (int)strtol(fields[2], &end, 10);
+    if (*end != '\0' || p->age < 1 || p->age > 120) {
+        return "invalid age";
+    }
+    
+    p->gender = (char)toupper((unsigned char)fields[3][0]);
+    if ((p->gender != 'M' && p->gender != 'F') || fields[3][1] != '\0') {
+        return "invalid gender";
+    }
+    
+    p->seatNumber = (int)strtol(fields[4], &end, 10);
+    if (*end != '\0' || p->seatNumber < 1 || p->seatNumber > MAX_SEATS) {
+        return "invalid seat";
+    }
+    
+    p->flightNumber = (int)strtol(fields[5], &end, 10);
+    if (*end != '\0' || p->flightNumber < 1) {
+        return "invalid flight number";
+    }
+    
+    p->fare = strtof(fields[6], &end);
+    if (*end != '\0' || p->fare < 0.0f) {
+        return "invalid fare";
+    }
+    
+    p->paymentMethod = (int)strtol(fields[7], &end, 10);
+    if (*end != '\0' || p->paymentMethod < 1 || p->paymentMethod > 4) {
+        return "invalid payment method";
+    }
+    
+    if (strcmp(fields[8], "booked") == 0) {
+        p->isBooked = 1;
+    } else if (strcmp(fields[8], "cancelled") == 0) {
+        p->isBooked = 0;
+    } else {
+        return "invalid status";
+    }
+    return NULL;
+}
+
+/**
+ * Add an import segment's collected time series counts to the flight's series
+ */
+static void flushImportSeries(ImportSegment *seg) {
+    if (seg->seriesBooked > 0 || seg->seriesCancelled > 0) {
+        seriesAdd(seg->flightNumber, seg->seriesHour, seg->seriesBooked, seg->seriesCancelled);
+    }
+    seg->seriesBooked = 0;
+    seg->seriesCancelled = 0;
+}
+
+/**
+ * Find the import segment open for a flight, or a free slot to open it in
+ * Returns NULL if the flight has none and every slot is in use
+ */
+static ImportSegment *findImportSegment(ImportSegment *cache, int flightNumber) {
+    ImportSegment *unused = NULL;
+    
+    for (int i = 0; i < IMPORT_OPEN_SEGMENTS; i++) {
+        if (cache[i].fp && cache[i].flightNumber == flightNumber) {
+            return &cache[i];
+        }
+        if (!cache[i].fp && !unused) {
+            unused = &cache[i];
+        }
+    }
+    return unused;
+}
+
+/**
+ * Lock a flight's segment and open it for buffered appends in a free slot
+ * Returns 0 if the segment could not be locked, read or opened
+ */
+static int openImportSegment(ImportSegment *seg, int flightNumber) {
+    memset(seg, 0, sizeof(ImportSegment));
+    seg->flightNumber = flightNumber;
+    if (!lockSegment(flightNumber)) {
+        return 0;
+    }
+    
+    // Seats are read only once the lock is held, so each batch sees what
+    // other sessions booked since the last one, and earlier imported rows
+    int count;
+    Passenger *records = loadSegment(flightNumber, &count);
+    if (count < 0 || !archivedSeatMap(flightNumber, seg->seats)) {
+        free(records);
+        unlockSegment(flightNumber);
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        if (records[i].isBooked && records[i].seatNumber >= 1 &&
+            records[i].seatNumber <= MAX_SEATS) {
+            seg->seats[records[i].seatNumber - 1] = 1;
+        }
+    }
+    free(records);
+    
+    seg->fp = openSegment(flightNumber, "ab");
+    if (!seg->fp) {
+        unlockSegment(flightNumber);
+        return 0;
+    }
+    setvbuf(seg->fp, NULL, _IOFBF, IMPORT_SEGMENT_BUFFER);
+    return 1;
+}
+
+/**
+ * Make the rows buffered so far durable together with their seat counts and
+ * change records, then close every segment and release its lock; the
+ * caller's commit is still open
+ * Returns 0 if any row, index entry, seat count or change record could not
+ * be written
+ */
+static int commitImportBatch(ReservationEngine *engine, ImportSegment *cache, FILE **indexFiles,
+                             ChangeRecord *changes, int *pendingChanges,
+                             char (*batchPnrs)[PNR_LEN + 1]) {
+    int ok = 1;
+    
+    // Later batches look this batch's PNRs up in the index
+    for (int i = 0; i < PNR_INDEX_BUCKETS; i++) {
+        if (indexFiles[i] && (fflush(indexFiles[i]) != 0 || ferror(indexFiles[i]))) {
+            ok = 0;
+        }
+    }
+    for (int i = 0; i < IMPORT_OPEN_SEGMENTS; i++) {
+        ImportSegment *seg = &cache[i];
+        if (!seg->fp) {
+            continue;
+        }
+        flushImportSeries(seg);
+        if (fflush(seg->fp) != 0 || ferror(seg->fp)) {
+            ok = 0;
+        }
+        if (seg->booked > 0 && !updateFlightSeats(engine, seg->flightNumber, -seg->booked)) {
+            ok = 0;
+        }
+        seg->booked = 0;
+    }
+    if (!logChanges(changes, *pendingChanges)) {
+        ok = 0;
+    }
+    *pendingChanges = 0;
+    
+    // Segments are released only once their rows are logged, so the log
+    // holds them in the order they were appended
+    for (int i = 0; i < IMPORT_OPEN_SEGMENTS; i++) {
+        if (cache[i].fp) {
+            if (fclose(cache[i].fp) != 0) {
+                ok = 0;
+            }
+            cache[i].fp = NULL;
+            unlockSegment(cache[i].flightNumber);
+        }
+    }
+    memset(batchPnrs, 0, IMPORT_PNR_SLOTS * sizeof(*batchPnrs));
+    return ok;
+}
+
+/**
+ * Find a PNR's slot in the current batch's set: the slot holding it, or the
+ * empty slot where it belongs
+ */
+static char *batchPnrSlot(char (*batchPnrs)[PNR_LEN + 1], const char *pnr) {
+    unsigned int h1, h2;
+    bloomHashes(pnr, &h1, &h2);
+    
+    // The set holds at most CHANGE_LOG_BATCH PNRs, so an empty slot is
+    // always found
+    unsigned int slot = h1 % IMPORT_PNR_SLOTS;
+    while (batchPnrs[slot][0] && strcmp(batchPnrs[slot], pnr) != 0) {
+        slot = (slot + 1) % IMPORT_PNR_SLOTS;
+    }
+    return batchPnrs[slot];
+}
+
+/**
+ * Check whether a PNR is already issued, including rows imported so far
+ * The current batch is checked in memory; the index on disk only holds rows
+ * of earlier batches, and is read only when the filter cannot rule it out
+ */
+static int importedPnrExists(const char *pnr, char (*batchPnrs)[PNR_LEN + 1]) {
+    if (batchPnrSlot(batchPnrs, pnr)[0]) {
+        return 1;
+    }
+    return findReservationFlight(pnr) != -1;
+}
+
+/**
+ * Bulk-load reservations from a CSV or NDJSON file
+ * Rows are committed in batches; segment locks are held for one batch only
+ * The first IMPORT_REPORT_LIMIT rejected rows are listed on report, if given
+ * Returns the number of rows imported, or -1 if the file could not be read
+ * or a batch could not be committed (batches committed before it remain)
+ */
+long engineImportReservations(ReservationEngine *engine, const char *path, long *rejected, FILE *report) {
+    FILE *in = fopen(path, "r");
+    *rejected = 0;
+    if (!in) {
+        return -1;
+    }
+    setvbuf(in, NULL, _IOFBF, EXPORT_BUFFER_SIZE);
+    
+    ImportSegment *cache = calloc(IMPORT_OPEN_SEGMENTS, sizeof(ImportSegment));
+    ChangeRecord *changes = calloc(CHANGE_LOG_BATCH, sizeof(ChangeRecord));
+    char (*batchPnrs)[PNR_LEN + 1] = calloc(IMPORT_PNR_SLOTS, sizeof(*batchPnrs));
+    int pendingChanges = 0, committed = cache && changes && batchPnrs;
+    FILE *indexFiles[PNR_INDEX_BUCKETS] = { NULL };
+    char line[IMPORT_LINE_LEN];
+    char fields[IMPORT_FIELDS][IMPORT_FIELD_LEN];
+    long lineNumber = 0, imported = 0;
+    
+    // Rows reach snapshots only together with their change records
+    beginCommit();
+    while (committed && fgets(line, sizeof(line), in)) {
+        lineNumber++;
+        const char *reason = NULL;
+        Passenger p;
+        
+        size_t len = strlen(line);
+        if (len > 0 && line[len - 1] != '\n' && !feof(in)) {
+            reason = "line too long";
+            int c;
+            while ((c = fgetc(in)) != '\n' && c != EOF);
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        
+        if (line[0] == '\0' || (lineNumber == 1 && strncmp(line, "pnr,", 4) == 0)) {
+            continue;  // Blank line or CSV header
+        }
+        
+        if (!reason) {
+            reason = splitImportLine(line, reservationImportKeys, IMPORT_FIELDS, fields);
+        }
+        
+        if (!reason) {
+            reason = buildImportedReservation(fields, &p);
+        }
+        if (!reason && !findFlight(engine, p.flightNumber)) {
+            reason = "unknown flight";
+        }
+        if (!reason && importedPnrExists(p.pnr, batchPnrs)) {
+            reason = "PNR already exists";
+        }
+        
+        ImportSegment *seg = NULL;
+        if (!reason) {
+            seg = findImportSegment(cache, p.flightNumber);
+            if (!seg) {
+                // Every slot is in use; committing the batch frees them all
+                committed = commitImportBatch(engine, cache, indexFiles, changes, &pendingChanges, batchPnrs);
+                endCommit();
+                beginCommit();
+                if (!committed) {
+                    break;
+                }
+                seg = findImportSegment(cache, p.flightNumber);
+            }
+            if (!seg->fp && !openImportSegment(seg, p.flightNumber)) {
+                reason = "could not open segment";
+            } else if (isFlightArchived(p.flightNumber) != 0) {
+                reason = "flight has departed and is archived";
+            } else if (p.isBooked && seg->seats[p.seatNumber - 1]) {
+                reason = "seat already booked";
+            } else if (p.isBooked && isSeatHeld(p.flightNumber, p.seatNumber)) {
+                reason = "seat held by a booking in progress";
+            }
+        }
+        
+        if (reason) {
+            if (report && *rejected < IMPORT_REPORT_LIMIT) {
+                fprintf(report, "Line %ld rejected: %s\n", lineNumber, reason);
+            }
+            (*rejected)++;
+            continue;
+        }
+        
+        // The filter learns the PNR before any of its data can reach disk
+        bloomAdd(p.pnr);
+        strcpy(batchPnrSlot(batchPnrs, p.pnr), p.pnr);
+        fwrite(&p, sizeof(Passenger), 1, seg->fp);
+        if (p.isBooked) {
+            seg->seats[p.seatNumber - 1] = 1;
+            seg->booked++;
+        }
+        
+        // Imported bookings count on the day in their PNR, collected per hour
+        time_t bookedAt = pnrBookingTime(p.pnr);
+        int hour = (int)((bookedAt ? bookedAt : time(NULL)) / 3600);
+        if (hour != seg->seriesHour || seg->seriesBooked >= USHRT_MAX) {
+            flushImportSeries(seg);
+            seg->seriesHour = hour;
+        }
+        seg->seriesBooked++;
+        seg->seriesCancelled += !p.isBooked;
+        
+        // Index the PNR through one buffered file per bucket
+        int bucket = pnrIndexBucket(p.pnr);
+        if (!indexFiles[bucket]) {
+            char indexPath[64];
+            pnrIndexPath(bucket, indexPath, sizeof(indexPath));
+            indexFiles[bucket] = fopen(indexPath, "ab");
+            if (indexFiles[bucket]) {
+                setvbuf(indexFiles[bucket], NULL, _IOFBF, IMPORT_INDEX_BUFFER);
+            }
+        }
+        if (indexFiles[bucket]) {
+            PnrIndexEntry entry;
+            memset(&entry, 0, sizeof(entry));
+            strcpy(entry.pnr, p.pnr);
+            entry.flightNumber = p.flightNumber;
+            fwrite(&entry, sizeof(PnrIndexEntry), 1, indexFiles[bucket]);
+        }
+        
+        // Followers replay imported rows from the change log
+        memset(&changes[pendingChanges], 0, sizeof(ChangeRecord));
+        changes[pendingChanges].type = CHANGE_RESERVATION_APPEND;
+        changes[pendingChanges].flags = CHANGE_FLAG_IMPORTED;
+        changes[pendingChanges].passenger = p;
+        imported++;
+        if (++pendingChanges == CHANGE_LOG_BATCH) {
+            committed = commitImportBatch(engine, cache, indexFiles, changes, &pendingChanges, batchPnrs);
+            endCommit();
+            beginCommit();
+        }
+    }
+    
+    if (committed) {
+        committed = commitImportBatch(engine, cache, indexFiles, changes, &pendingChanges, batchPnrs);
+    }
+    endCommit();
+    for (int i = 0; i < PNR_INDEX_BUCKETS; i++) {
+        if (indexFiles[i] && fclose(indexFiles[i]) != 0) {
+            committed = 0;
+        }
+    }
+    if (!committed && report) {
+        fprintf(report, "Import stopped at line %ld: could not commit the imported rows\n", lineNumber);
+    }
+    free(batchPnrs);
+    free(changes);
+    free(cache);
+    fclose(in);
+    return committed ? imported : -1;
+}
+
+/**
+ * Validate schedule fields and build a flight with every seat free
+ * Returns NULL on success or a short reason for rejecting the row
+ */
+static const char *buildScheduledFlight(char fields[][IMPORT_FIELD_LEN], Flight *flight) {
+    char *end;
+    
+    memset(flight, 0, sizeof(Flight));
+    
+    long number = strtol(fields[0], &end, 10);
+    if (*end != '\0' || number < 1 || number > 999999) {
+        return "invalid flight number";
+    }
+    flight->flightNumber = (int)number;
+    
+    if (fields[1][0] == '\0' || strlen(fields[1]) > MAX_DEST_LEN) {
+        return "invalid departure city";
+    }
+    strcpy(flight->departure, fields[1]);
+    
+    if (fields[2][0] == '\0' || strlen(fields[2]) > MAX_DEST_LEN) {
+        return "invalid destination";
+    }
+    strcpy(flight->destination, fields[2]);
+    
+    if (strlen(fields[3]) > MAX_DATE_LEN || engineParseFlightDate(fields[3]) < 0) {
+        return "invalid date";
+    }
+    strcpy(flight->date, fields[3]);
+    
+    if (strlen(fields[4]) > MAX_TIME_LEN) {
+        return "invalid time";
+    }
+    strcpy(flight->time, fields[4]);
+    if (engineDepartureMinutes(flight) < 0) {
+        return "invalid time";
+    }
+    
+    long duration = strtol(fields[5], &end, 10);
+    if (*end != '\0' || duration < 1 || duration > 48 * 60) {
+        return "invalid duration";
+    }
+    flight->durationMinutes = (int)duration;
+    
+    flight->baseFare = strtof(fields[6], &end);
+    if (*end != '\0' || fields[6][0] == '\0' || !(flight->baseFare >= 0.0f)) {
+        return "invalid base fare";
+    }
+    
+    flight->availableSeats = MAX_SEATS;
+    flight->fareBucket = 0;
+    repriceFlight(flight);
+    return NULL;
+}
+
+/**
+ * Order schedule rows by flight number, then by line
+ */
+static int compareScheduleNumber(const void *a, const void *b) {
+    const ScheduleRow *x = a, *y = b;
+    if (x->flight.flightNumber != y->flight.flightNumber) {
+        return x->flight.flightNumber < y->flight.flightNumber ? -1 : 1;
+    }
+    return (x->line > y->line) - (x->line < y->line);
+}
+
+/**
+ * Order schedule rows by line
+ */
+static int compareScheduleLine(const void *a, const void *b) {
+    const ScheduleRow *x = a, *y = b;
+    return (x->line > y->line) - (x->line < y->line);
+}
+
+/**
+ * Order rejected schedule rows by line
+ */
+static int compareScheduleReject(const void *a, const void *b) {
+    const ScheduleReject *x = a, *y = b;
+    return (x->line > y->line) - (x->line < y->line);
+}
+
+/**
+ * Remember a rejected schedule row, growing the list as needed
+ */
+static int rejectScheduleRow(ScheduleReject **rejects, long *count, long *cap,
+                             long line, const char *reason) {
+    if (*count == *cap) {
+        long newCap = *cap ? *cap * 2 : 64;
+        ScheduleReject *grown = realloc(*rejects, (size_t)newCap * sizeof(ScheduleReject));
+        if (!grown) {
+            return 0;
+        }
+        *rejects = grown;
+        *cap = newCap;
+    }
+    (*rejects)[*count].line = line;
+    (*rejects)[*count].reason = reason;
+    (*count)++;
+    return 1;
+}
+
+/**
+ * Bulk-load a flight schedule from a CSV or NDJSON file in the engineExportFlights
+ * layout, skipping flight numbers already in use or repeated in the file
+ * The first IMPORT_REPORT_LIMIT rejected rows are listed on report, if given
+ * Returns the number of flights added, or -1 if the file could not be read
+ * or the flights could not be written
+ */
+long engineImportSchedule(ReservationEngine *engine, const char *path, long *rejected, FILE *report) {
+    *rejected = 0;
+    if (engine->readOnly) {
+        return -1;
+    }
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        return -1;
+    }
+    setvbuf(in, NULL, _IOFBF, EXPORT_BUFFER_SIZE);
+    
+    ScheduleRow *rows = NULL;
+    ScheduleReject *rejects = NULL;
+    long rowCount = 0, rowCap = 0, rejectCount = 0, rejectCap = 0;
+    char line[IMPORT_LINE_LEN];
+    char fields[SCHEDULE_FIELDS][IMPORT_FIELD_LEN];
+    long lineNumber = 0;
+    int ok = 1;
+    
+    // Validate every row first; nothing is written until the batch is known
+    while (ok && fgets(line, sizeof(line), in)) {
+        lineNumber++;
+        const char *reason = NULL;
+        Flight flight;
+        
+        size_t len = strlen(line);
+        if (len > 0 && line[len - 1] != '\n' && !feof(in)) {
+            reason = "line too long";
+            int c;
+            while ((c = fgetc(in)) != '\n' && c != EOF);
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        
+        if (line[0] == '\0' || (lineNumber == 1 && strncmp(line, "flight,", 7) == 0)) {
+            continue;  // Blank line or CSV header
+        }
+        
+        if (!reason) {
+            reason = splitImportLine(line, scheduleImportKeys, SCHEDULE_FIELDS, fields);
+        }
+        if (!reason) {
+            reason = buildScheduledFlight(fields, &flight);
+        }
+        if (reason) {
+            ok = rejectScheduleRow(&rejects, &rejectCount, &rejectCap, lineNumber, reason);
+            continue;
+        }
+        
+        if (rowCount == rowCap) {
+            long newCap = rowCap ? rowCap * 2 : 64;
+            ScheduleRow *grown = realloc(rows, (size_t)newCap * sizeof(ScheduleRow));
+            if (!grown) {
+                ok = 0;
+                break;
+            }
+            rows = grown;
+            rowCap = newCap;
+        }
+        rows[rowCount].flight = flight;
+        rows[rowCount].line = lineNumber;
+        rowCount++;
+    }
+    fclose(in);
+    
+    int *existing = NULL;
+    int existingCount = 0;
+    if (ok && rowCount > 0) {
+        ok = syncFlights(engine);
+        existingCount = engine->flightCount;
+        existing = malloc(((size_t)existingCount + 1) * sizeof(int));
+        ok = ok && existing;
+    }
+    
+    long accepted = 0;
+    if (ok && rowCount > 0) {
+        for (int i = 0; i < existingCount; i++) {
+            existing[i] = engine->flights[i].flightNumber;
+        }
+        qsort(existing, (size_t)existingCount, sizeof(int), compareFlightNumber);
+        qsort(rows, (size_t)rowCount, sizeof(ScheduleRow), compareScheduleNumber);
+        
+        // One pass over both sorted lists; the first row of a number wins
+        int e = 0;
+        for (long i = 0; ok && i < rowCount; i++) {
+            int number = rows[i].flight.flightNumber;
+            while (e < existingCount && existing[e] < number) {
+                e++;
+            }
+            const char *reason = NULL;
+            if (e < existingCount && existing[e] == number) {
+                reason = "flight number already exists";
+            } else if (i > 0 && rows[i - 1].flight.flightNumber == number) {
+                reason = "duplicate flight number in file";
+            }
+            if (reason) {
+                ok = rejectScheduleRow(&rejects, &rejectCount, &rejectCap, rows[i].line, reason);
+            } else {
+                rows[accepted++] = rows[i];
+            }
+        }
+        
+        // Keep the schedule's own order in flights.dat
+        qsort(rows, (size_t)accepted, sizeof(ScheduleRow), compareScheduleLine);
+    }
+    free(existing);
+    
+    if (ok && accepted > 0) {
+        Flight *flights = malloc((size_t)accepted * sizeof(Flight));
+        unsigned char *taken = calloc((size_t)accepted, 1);
+        ChangeRecord *changes = calloc(CHANGE_LOG_BATCH, sizeof(ChangeRecord));
+        ok = flights && taken && changes;
+        for (long i = 0; ok && i < accepted; i++) {
+            flights[i] = rows[i].flight;
+        }
+        
+        // Another session may have added some of the numbers since they were
+        // checked; appendFlights checks again under its lock and skips them
+        beginCommit();
+        ok = ok && appendFlights(engine, flights, (int)accepted, taken) >= 0;
+        
+        // Followers add the flights from the change log
+        int pending = 0;
+        for (long i = 0; ok && i < accepted; i++) {
+            if (taken[i]) {
+                ok = rejectScheduleRow(&rejects, &rejectCount, &rejectCap, rows[i].line,
+                                       "flight number already exists");
+            } else {
+                memset(&changes[pending], 0, sizeof(ChangeRecord));
+                changes[pending].type = CHANGE_FLIGHT_PUT;
+                changes[pending].flight = flights[i];
+                pending++;
+            }
+            if (pending == CHANGE_LOG_BATCH || i + 1 == accepted) {
+                logChanges(changes, pending);
+                pending = 0;
+            }
+        }
+        endCommit();
+        
+        long added = 0;
+        for (long i = 0; ok && i < accepted; i++) {
+            added += !taken[i];
+        }
+        accepted = added;
+        free(changes);
+        free(taken);
+        free(flights);
+    }
+    
+    if (ok) {
+        qsort(rejects, (size_t)rejectCount, sizeof(ScheduleReject), compareScheduleReject);
+        for (long i = 0; report && i < rejectCount && i < IMPORT_REPORT_LIMIT; i++) {
+            fprintf(report, "Line %ld rejected: %s\n", rejects[i].line, rejects[i].reason);
+        }
+        *rejected = rejectCount;
+    }
+    free(rejects);
+    free(rows);
+    return ok ? accepted : -1;
+}
+
+/* ================ CONNECTING ITINERARIES ================ */
+
+/*
+ * Itinerary search runs on an in-memory route graph: one node per city
+ * and one leg per dated flight. Each city keeps its outbound legs sorted by
+ * departure, so the connections that respect the minimum and maximum
+ * layover are found by binary search. The graph is built once from
+ * flights.dat. After that it is brought up to date by replaying the flight
+ * records appended to the change log since the last search, so seat-count
+ * changes and new or deleted flights cost O(1) or O(legs per city) each.
+ */
+
+typedef struct {
+    Flight flight;
+    long departs;                     // Minutes since 1970-01-01
+    long arrives;
+    int origin;                       // City ids
+    int destination;
+    int active;
+} RouteLeg;
+
+typedef struct {
+    char name[MAX_DEST_LEN + 1];
+    int *outbound;                    // Leg ids sorted by departure
+    int outboundCount;
+    int outboundCap;
+    int *inbound;                     // Leg ids arriving here, unordered
+    int inboundCount;
+    int inboundCap;
+} RouteCity;
+
+typedef struct {
+    int legs[ITINERARY_MAX_LEGS];     // Leg ids
+    int legCount;
+    float fare;
+    long duration;                    // First departure to last arrival, minutes
+} RouteCandidate;
+
+typedef struct {
+    RouteLeg *legs;
+    int legCount;
+    int legCap;
+    RouteCity *cities;
+    int cityCount;
+    int cityCap;
+    int *cityTable;                   // Open addressing, city id + 1 (0 = empty)
+    int cityTableSize;
+    int *flightTable;                 // Open addressing, leg id + 1 (0 = empty)
+    int flightTableSize;
+    long long logPosition;            // Change log records already applied
+    long long logId;                  // Log the position refers to
+    int built;
+} RouteGraph;
+
+static RouteGraph routeGraph;
+
+/**
+ * Case-insensitive hash of a city name
+ */
+static unsigned int cityHash(const char *name) {
+    unsigned int h = 2166136261u;
+    for (; *name; name++) {
+        h = (h ^ (unsigned char)tolower((unsigned char)*name)) * 16777619u;
+    }
+    return h;
+}
+
+/**
+ * Append an int to a growable array
+ */
+static int appendInt(int **items, int *count, int *cap, int value) {
+    if (*count == *cap) {
+        int newCap = *cap ? *cap * 2 : 8;
+        int *grown = realloc(*items, newCap * sizeof(int));
+        if (!grown) {
+            return 0;
+        }
+        *items = grown;
+        *cap = newCap;
+    }
+    (*items)[(*count)++] = value;
+    return 1;
+}
+
+/**
+ * Rebuild an open-addressing table at twice its size
+ */
+static void growRouteTable(int **table, int *size, int isCityTable) {
+    int newSize = *size ? *size * 2 : 64;
+    int *grown = calloc(newSize, sizeof(int));
+    if (!grown) {
+        return;
+    }
+    
+    for (int i = 0; i < *size; i++) {
+        int id = (*table)[i] - 1;
+        if (id < 0) {
+            continue;
+        }
+        unsigned int h = isCityTable ? cityHash(routeGraph.cities[id].name)
+                                     : (unsigned int)routeGraph.legs[id].flight.flightNumber * 2654435761u;
+        unsigned int slot = h & (newSize - 1);
+        while (grown[slot]) {
+            slot = (slot + 1) & (newSize - 1);
+        }
+        grown[slot] = id + 1;
+    }
+    
+    free(*table);
+    *table = grown;
+    *size = newSize;
+}
+
+/**
+ * Find a city id by name, optionally adding it; -1 if absent
+ */
+static int findCity(const char *name, int create) {
+    RouteGraph *g = &routeGraph;
+    
+    if (create && (g->cityCount + 1) * 2 > g->cityTableSize) {
+        growRouteTable(&g->cityTable, &g->cityTableSize, 1);
+    }
+    if (g->cityTableSize == 0) {
+        return -1;
+    }
+    
+    unsigned int slot = cityHash(name) & (g->cityTableSize - 1);
+    while (g->cityTable[slot]) {
+        int id = g->cityTable[slot] - 1;
+        if (strcasecmp(g->cities[id].name, name) == 0) {
+            return id;
+        }
+        slot = (slot + 1) & (g->cityTableSize - 1);
+    }
+    if (!create) {
+        return -1;
+    }
+    
+    if (g->cityCount == g->cityCap) {
+        int newCap = g->cityCap ? g->cityCap * 2 : 64;
+        RouteCity *grown = realloc(g->cities, newCap * sizeof(RouteCity));
+        if (!grown) {
+            return -1;
+        }
+        g->cities = grown;
+        g->cityCap = newCap;
+    }
+    
+    int id = g->cityCount++;
+    memset(&g->cities[id], 0, sizeof(RouteCity));
+    strcpy(g->cities[id].name, name);
+    g->cityTable[slot] = id + 1;
+    return id;
+}
+
+/**
+ * Find the leg id for a flight number, or -1
+ */
+static int findLeg(int flightNumber) {
+    RouteGraph *g = &routeGraph;
+    if (g->flightTableSize == 0) {
+        return -1;
+    }
+    
+    unsigned int slot = ((unsigned int)flightNumber * 2654435761u) & (g->flightTableSize - 1);
+    while (g->flightTable[slot]) {
+        int id = g->flightTable[slot] - 1;
+        if (g->legs[id].flight.flightNumber == flightNumber) {
+            return id;
+        }
+        slot = (slot + 1) & (g->flightTableSize - 1);
+    }
+    return -1;
+}
+
+/**
+ * Index of the first outbound leg departing at or after a time
+ */
+static int firstLegAfter(const RouteCity *city, long time) {
+    int lo = 0, hi = city->outboundCount;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (routeGraph.legs[city->outbound[mid]].departs < time) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * Remove a leg id from an int array
+ * Returns 0 if it was not there
+ */
+static int removeInt(int *items, int *count, int value) {
+    for (int i = 0; i < *count; i++) {
+        if (items[i] == value) {
+            memmove(&items[i], &items[i + 1], (*count - i - 1) * sizeof(int));
+            (*count)--;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Take a flight out of the graph
+ */
+static void routeGraphRemove(int flightNumber) {
+    int id = findLeg(flightNumber);
+    if (id < 0 || !routeGraph.legs[id].active) {
+        return;
+    }
+    
+    RouteLeg *leg = &routeGraph.legs[id];
+    RouteCity *origin = &routeGraph.cities[leg->origin];
+    RouteCity *destination = &routeGraph.cities[leg->destination];
+    
+    int from = firstLegAfter(origin, leg->departs);
+    int later = origin->outboundCount - from;
+    if (removeInt(origin->outbound + from, &later, id)) {
+        origin->outboundCount--;
+    }
+    removeInt(destination->inbound, &destination->inboundCount, id);
+    leg->active = 0;  // The slot is reused if the flight number comes back
+}
+
+/**
+ * Add or update a flight in the graph
+ * Undated flights cannot be connected and are left out
+ */
+static void routeGraphPut(const Flight *flight) {
+    RouteGraph *g = &routeGraph;
+    long departs = engineDepartureMinutes(flight);
+    int id = findLeg(flight->flightNumber);
+    
+    if (id >= 0 && g->legs[id].active) {
+        RouteLeg *leg = &g->legs[id];
+        if (departs == leg->departs && flight->durationMinutes > 0 &&
+            strcasecmp(flight->departure, g->cities[leg->origin].name) == 0 &&
+            strcasecmp(flight->destination, g->cities[leg->destination].name) == 0) {
+            // Same route and time: seat or fare change, updated in place
+            leg->flight = *flight;
+            leg->arrives = departs + flight->durationMinutes;
+            return;
+        }
+        routeGraphRemove(flight->flightNumber);
+    }
+    
+    if (departs < 0 || flight->durationMinutes <= 0) {
+        return;
+    }
+    
+    if (id < 0) {
+        if ((g->legCount + 1) * 2 > g->flightTableSize) {
+            growRouteTable(&g->flightTable, &g->flightTableSize, 0);
+        }
+        if (g->legCount == g->legCap) {
+            int newCap = g->legCap ? g->legCap * 2 : 256;
+            RouteLeg *grown = realloc(g->legs, newCap * sizeof(RouteLeg));
+            if (!grown) {
+                return;
+            }
+            g->legs = grown;
+            g->legCap = newCap;
+        }
+        
+        id = g->legCount++;
+        unsigned int slot = ((unsigned int)flight->flightNumber * 2654435761u) & (g->flightTableSize - 1);
+        while (g->flightTable[slot]) {
+            slot = (slot + 1) & (g->flightTableSize - 1);
+        }
+        g->flightTable[slot] = id + 1;
+    }
+    
+    int origin = findCity(flight->departure, 1);
+    int destination = findCity(flight->destination, 1);
+    if (origin < 0 || destination < 0) {
+        return;
+    }
+    
+    RouteLeg *leg = &g->legs[id];
+    leg->flight = *flight;
+    leg->departs = departs;
+    leg->arrives = departs + flight->durationMinutes;
+    leg->origin = origin;
+    leg->destination = destination;
+    leg->active = 1;
+    
+    // Keep the origin's outbound list sorted by departure
+    RouteCity *city = &g->cities[origin];
+    int at = firstLegAfter(city, departs);
+    if (!appendInt(&city->outbound, &city->outboundCount, &city->outboundCap, id)) {
+        leg->active = 0;
+        return;
+    }
+    memmove(&city->outbound[at + 1], &city->outbound[at],
+            (city->outboundCount - 1 - at) * sizeof(int));
+    city->outbound[at] = id;
+    
+    city = &g->cities[destination];
+    appendInt(&city->inbound, &city->inboundCount, &city->inboundCap, id);
+}
+
+/**
+ * Build the graph on first use, then apply flight changes from the log
+ */
+static void refreshRouteGraph(ReservationEngine *engine) {
+    RouteGraph *g = &routeGraph;
+    long long records, logId;
+    FILE *log = openChangeLog(followLogDir[0] ? followLogDir : changeLogDir, &records, &logId);
+    
+    if (g->built && (records < g->logPosition || logId != g->logId)) {
+        g->built = 0;  // The log was reset; start over from flights.dat
+    }
+    
+    if (!g->built) {
+        for (int i = 0; i < g->cityCount; i++) {
+            free(g->cities[i].outbound);
+            free(g->cities[i].inbound);
+        }
+        free(g->legs);
+        free(g->cities);
+        free(g->cityTable);
+        free(g->flightTable);
+        memset(g, 0, sizeof(RouteGraph));
+        
+        // Replaying records from here on is safe: puts and deletes are idempotent
+        g->logPosition = followLogDir[0] ? replicaApplied : records;
+        g->logId = logId;
+        
+        syncFlights(engine);
+        for (int i = 0; i < engine->flightCount; i++) {
+            routeGraphPut(&engine->flights[i]);
+        }
+        g->built = 1;
+    }
+    
+    if (log && g->logPosition < records) {
+        ChangeRecord change;
+        fseek(log, (long)(g->logPosition * sizeof(ChangeRecord)), SEEK_SET);
+        while (fread(&change, sizeof(ChangeRecord), 1, log) == 1) {
+            if (change.type == CHANGE_FLIGHT_PUT) {
+                routeGraphPut(&change.flight);
+            } else if (change.type == CHANGE_FLIGHT_DELETE) {
+                routeGraphRemove(change.flight.flightNumber);
+            }
+            g->logPosition = change.sequence;
+        }
+    }
+    
+    if (log) {
+        fclose(log);
+    }
+}
+
+/**
+ * Insert an itinerary into the ranked result list if it makes the cut
+ */
+static void rankItinerary(RouteCandidate *results, int *count, int maxResults,
+                          const RouteCandidate *candidate, int byDuration) {
+    int pos = *count;
+    while (pos > 0) {
+        const RouteCandidate *other = &results[pos - 1];
+        int better = byDuration
+            ? (candidate->duration < other->duration ||
+               (candidate->duration == other->duration && candidate->fare < other->fare))
+            : (candidate->fare < other->fare ||
+               (candidate->fare == other->fare && candidate->duration < other->duration));
+        if (!better) {
+            break;
+        }
+        pos--;
+    }
+    
+    if (pos >= maxResults) {
+        return;
+    }
+    if (*count < maxResults) {
+        (*count)++;
+    }
+    memmove(&results[pos + 1], &results[pos], (*count - 1 - pos) * sizeof(RouteCandidate));
+    results[pos] = *candidate;
+}
+
+/**
+ * Record a complete itinerary made of the given legs
+ */
+static void offerItinerary(RouteCandidate *results, int *count, int maxResults,
+                           const int *legs, int legCount, int byDuration) {
+    RouteCandidate candidate;
+    candidate.legCount = legCount;
+    candidate.fare = 0.0f;
+    for (int i = 0; i < legCount; i++) {
+        candidate.legs[i] = legs[i];
+        candidate.fare += engineFlightFare(&routeGraph.legs[legs[i]].flight);
+    }
+    candidate.duration = routeGraph.legs[legs[legCount - 1]].arrives - routeGraph.legs[legs[0]].departs;
+    rankItinerary(results, count, maxResults, &candidate, byDuration);
+}
+
+/**
+ * Find the best direct, one-stop and two-stop itineraries departing on a day
+ * Every leg must have a free seat and each layover must be between
+ * MIN_CONNECTION_MINUTES and MAX_CONNECTION_MINUTES
+ * Returns the number of itineraries written to results
+ */
+int engineSearchItineraries(ReservationEngine *engine, const char *from, const char *to, long day,
+                            int byDuration, Itinerary *itineraries, int maxResults) {
+    refreshRouteGraph(engine);
+    
+    RouteCandidate results[ITINERARY_RESULTS];
+    if (maxResults > ITINERARY_RESULTS) {
+        maxResults = ITINERARY_RESULTS;
+    }
+    
+    RouteGraph *g = &routeGraph;
+    int origin = findCity(from, 0);
+    int destination = findCity(to, 0);
+    if (origin < 0 || destination < 0 || origin == destination) {
+        return 0;
+    }
+    
+    // Cities with a direct leg into the destination, to prune two-stop search
+    unsigned char *feedsDestination = calloc(g->cityCount, 1);
+    if (!feedsDestination) {
+        return 0;
+    }
+    const RouteCity *target = &g->cities[destination];
+    for (int i = 0; i < target->inboundCount; i++) {
+        feedsDestination[g->legs[target->inbound[i]].origin] = 1;
+    }
+    
+    int count = 0;
+    int path[ITINERARY_MAX_LEGS];
+    const RouteCity *start = &g->cities[origin];
+    
+    for (int a = firstLegAfter(start, day * 1440); a < start->outboundCount; a++) {
+        const RouteLeg *first = &g->legs[start->outbound[a]];
+        if (first->departs >= (day + 1) * 1440) {
+            break;
+        }
+        if (first->flight.availableSeats <= 0) {
+            continue;
+        }
+        path[0] = start->outbound[a];
+        
+        if (first->destination == destination) {
+            offerItinerary(results, &count, maxResults, path, 1, byDuration);
+            continue;
+        }
+        if (first->destination == origin) {
+            continue;
+        }
+        
+        const RouteCity *via = &g->cities[first->destination];
+        for (int b = firstLegAfter(via, first->arrives + MIN_CONNECTION_MINUTES);
+             b < via->outboundCount; b++) {
+            const RouteLeg *second = &g->legs[via->outbound[b]];
+            if (second->departs > first->arrives + MAX_CONNECTION_MINUTES) {
+                break;
+            }
+            if (second->flight.availableSeats <= 0 || second->destination == origin) {
+                continue;
+            }
+            path[1] = via->outbound[b];
+            
+            if (second->destination == destination) {
+                offerItinerary(results, &count, maxResults, path, 2, byDuration);
+                continue;
+            }
+            if (second->destination == first->destination || !feedsDestination[second->destination]) {
+                continue;
+            }
+            
+            const RouteCity *via2 = &g->cities[second->destination];
+            for (int c = firstLegAfter(via2, second->arrives + MIN_CONNECTION_MINUTES);
+                 c < via2->outboundCount; c++) {
+                const RouteLeg *third = &g->legs[via2->outbound[c]];
+                if (third->departs > second->arrives + MAX_CONNECTION_MINUTES) {
+                    break;
+                }
+                if (third->destination == destination && third->flight.availableSeats > 0) {
+                    path[2] = via2->outbound[c];
+                    offerItinerary(results, &count, maxResults, path, 3, byDuration);
+                }
+            }
+        }
+    }
+    
+    free(feedsDestination);
+    
+    // Hand back copies of the legs; the graph changes on the next refresh
+    for (int i = 0; i < count; i++) {
+        itineraries[i].legCount = results[i].legCount;
+        itineraries[i].fare = results[i].fare;
+        itineraries[i].duration = results[i].duration;
+        for (int l = 0; l < results[i].legCount; l++) {
+            itineraries[i].legs[l] = g->legs[results[i].legs[l]].flight;
+        }
+    }
+    return count;
+}
+
+/* ================ RESERVATION LISTING ================ */
+
+/*
+ * Paged listings are served from an in-memory index rather than by reading
+ * every segment. Reservations are kept in sorted id lists, one per
+ * (status, payment method) pair, in two orders: by flight then PNR, and by
+ * name (case-insensitive) then PNR. A page seeks each list that matches
+ * the status and payment filters to its starting key and merges them, so
+ * it costs a few binary searches plus the rows it returns.
+ *
+ * Each list is a sequence of sorted chunks of up to LISTING_CHUNK ids. A
+ * seek is a binary search over the chunks' last rows and then within one
+ * chunk; an insert or removal moves ids within that chunk only, and a full
+ * chunk is split in two, so keeping the index current costs O(log n) per
+ * change plus a bounded move rather than a move of the whole list.
+ *
+ * The index is built once from a snapshot, which records the change log
+ * position it reflects, and then kept current by replaying the reservation
+ * records logged after it, as the route graph does for flights. If the
+ * index cannot take a change (out of memory), it is dropped and the next
+ * listing builds it again. A primary whose change log cannot be opened has
+ * nothing to replay, so it builds the index from a new snapshot for every
+ * page, which reads every segment.
+ *
+ * Cursors carry the sort key of the last row returned, so a listing
+ * resumes after it even if rows were added or cancelled in between.
+ */
+
+typedef struct {
+    int ids[LISTING_CHUNK];
+    int count;
+} ListingChunk;
+
+typedef struct {
+    ListingChunk **chunks;            // Never empty; row ids in listing order across them
+    int chunkCount;
+    int chunkCap;
+} ListingList;
+
+typedef struct {
+    int chunk;                        // chunk == chunkCount past the last row
+    int offset;
+} ListingPos;
+
+typedef struct {
+    Passenger *rows;
+    int rowCount;                     // Row ids handed out so far
+    int rowCap;
+    int *freeRows;                    // Ids of removed rows, reused first
+    int freeCount;
+    int freeCap;
+    ListingList byFlight[LISTING_PARTITIONS];
+    ListingList byName[LISTING_PARTITIONS];
+    long long logPosition;            // Change log records already applied
+    long long logId;                  // Log the position refers to
+    int built;
+} ListingIndex;
+
+typedef struct {
+    unsigned char version;
+    unsigned char order;              // LISTING_ORDER_*
+    int isBooked;                     // Sort key of the last row returned
+    int flightNumber;
+    int seatNumber;
+    char pnr[PNR_LEN + 1];
+    char name[MAX_NAME_LEN + 1];
+    unsigned int filterHash;          // Cursors only resume the listing they came from
+    unsigned int check;
+} ListingCursor;
+
+typedef struct {
+    int *ids[2 * LISTING_PARTITIONS]; // byFlight lists, then byName lists
+    int count[2 * LISTING_PARTITIONS];
+    int cap[2 * LISTING_PARTITIONS];
+    int failed;
+} ListingBuild;
+
+static ListingIndex listingIndex;
+static int listingSortOrder;          // Order used by the qsort comparator
+
+/**
+ * Which (status, payment method) list a reservation belongs to
+ */
+static int listingPartition(const Passenger *p) {
+    return (p->isBooked ? 4 : 0) + ((p->paymentMethod - 1) & 3);
+}
+
+/**
+ * Compare two reservations in a listing order
+ */
+static int compareListing(int order, const Passenger *a, const Passenger *b) {
+    int c;
+    if (order == LISTING_ORDER_NAME && (c = strcasecmp(a->name, b->name)) != 0) {
+        return c;
+    }
+    if (order == LISTING_ORDER_FLIGHT && a->flightNumber != b->flightNumber) {
+        return a->flightNumber < b->flightNumber ? -1 : 1;
+    }
+    if ((c = strcmp(a->pnr, b->pnr)) != 0) {
+        return c;
+    }
+    if (a->flightNumber != b->flightNumber) {
+        return a->flightNumber < b->flightNumber ? -1 : 1;
+    }
+    if (a->seatNumber != b->seatNumber) {
+        return a->seatNumber < b->seatNumber ? -1 : 1;
+    }
+    return a->isBooked - b->isBooked;
+}
+
+/**
+ * qsort comparator for row ids in listingSortOrder
+ */
+static int compareListingIds(const void *a, const void *b) {
+    return compareListing(listingSortOrder, &listingIndex.rows[*(const int *)a],
+                          &listingIndex.rows[*(const int *)b]);
+}
+
+/**
+ * Whether a row lies before the seek target: sorts before key, or equal to
+ * it when seeking past it
+ */
+static int listingBefore(int order, int id, const Passenger *key, int after) {
+    int c = compareListing(order, &listingIndex.rows[id], key);
+    return c < 0 || (after && c == 0);
+}
+
+/**
+ * First position whose row sorts after key (after = 1) or not before it
+ */
+static ListingPos listingSeek(const ListingList *list, int order, const Passenger *key, int after) {
+    ListingPos pos;
+    int lo = 0, hi = list->chunkCount;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        const ListingChunk *chunk = list->chunks[mid];
+        if (listingBefore(order, chunk->ids[chunk->count - 1], key, after)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    pos.chunk = lo;
+    pos.offset = 0;
+    if (lo == list->chunkCount) {
+        return pos;
+    }
+    
+    // The chunk's last row is not before the target, so the position is in it
+    const ListingChunk *chunk = list->chunks[lo];
+    hi = chunk->count - 1;
+    while (pos.offset < hi) {
+        int mid = (pos.offset + hi) / 2;
+        if (listingBefore(order, chunk->ids[mid], key, after)) {
+            pos.offset = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return pos;
+}
+
+/**
+ * Row id at a position, or -1 past the last row
+ */
+static int listingAt(const ListingList *list, ListingPos pos) {
+    return pos.chunk < list->chunkCount ? list->chunks[pos.chunk]->ids[pos.offset] : -1;
+}
+
+/**
+ * Step a position to the next row
+ */
+static void listingNext(const ListingList *list, ListingPos *pos) {
+    if (pos->chunk < list->chunkCount && ++pos->offset == list->chunks[pos->chunk]->count) {
+        pos->chunk++;
+        pos->offset = 0;
+    }
+}
+
+/**
+ * Insert an empty chunk at index at, returning it or NULL
+ */
+static ListingChunk *addListingChunk(ListingList *list, int at) {
+    if (list->chunkCount == list->chunkCap) {
+        int newCap = list->chunkCap ? list->chunkCap * 2 : 8;
+        ListingChunk **grown = realloc(list->chunks, newCap * sizeof(ListingChunk *));
+        if (!grown) {
+            return NULL;
+        }
+        list->chunks = grown;
+        list->chunkCap = newCap;
+    }
+    ListingChunk *chunk = malloc(sizeof(ListingChunk));
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->count = 0;
+    memmove(&list->chunks[at + 1], &list->chunks[at], (list->chunkCount - at) * sizeof(ListingChunk *));
+    list->chunks[at] = chunk;
+    list->chunkCount++;
+    return chunk;
+}
+
+/**
+ * Insert a row id into a list at its sorted position
+ * Returns 0 if out of memory, leaving the list unchanged
+ */
+static int listingInsert(ListingList *list, int order, int id) {
+    if (list->chunkCount == 0 && !addListingChunk(list, 0)) {
+        return 0;
+    }
+    
+    ListingPos pos = listingSeek(list, order, &listingIndex.rows[id], 1);
+    if (pos.chunk == list->chunkCount) {
+        pos.chunk--;  // After every row: the end of the last chunk
+        pos.offset = list->chunks[pos.chunk]->count;
+    }
+    
+    // A full chunk is split in half and the insert goes to the half it falls in
+    if (list->chunks[pos.chunk]->count == LISTING_CHUNK) {
+        ListingChunk *right = addListingChunk(list, pos.chunk + 1);
+        if (!right) {
+            return 0;
+        }
+        ListingChunk *left = list->chunks[pos.chunk];
+        right->count = LISTING_CHUNK / 2;
+        left->count = LISTING_CHUNK - right->count;
+        memcpy(right->ids, &left->ids[left->count], right->count * sizeof(int));
+        if (pos.offset > left->count) {
+            pos.offset -= left->count;
+            pos.chunk++;
+        }
+    }
+    
+    ListingChunk *chunk = list->chunks[pos.chunk];
+    memmove(&chunk->ids[pos.offset + 1], &chunk->ids[pos.offset], (chunk->count - pos.offset) * sizeof(int));
+    chunk->ids[pos.offset] = id;
+    chunk->count++;
+    return 1;
+}
+
+/**
+ * Remove a row id from a list
+ */
+static void listingErase(ListingList *list, int order, int id) {
+    ListingPos pos = listingSeek(list, order, &listingIndex.rows[id], 0);
+    while (pos.chunk < list->chunkCount && listingAt(list, pos) != id) {
+        listingNext(list, &pos);  // Past other rows with an identical key
+    }
+    if (pos.chunk == list->chunkCount) {
+        return;
+    }
+    
+    ListingChunk *chunk = list->chunks[pos.chunk];
+    memmove(&chunk->ids[pos.offset], &chunk->ids[pos.offset + 1], (chunk->count - pos.offset - 1) * sizeof(int));
+    if (--chunk->count == 0) {
+        free(chunk);
+        memmove(&list->chunks[pos.chunk], &list->chunks[pos.chunk + 1],
+                (list->chunkCount - pos.chunk - 1) * sizeof(ListingChunk *));
+        list->chunkCount--;
+    }
+}
+
+/**
+ * Free a list's chunks
+ */
+static void freeListingList(ListingList *list) {
+    for (int i = 0; i < list->chunkCount; i++) {
+        free(list->chunks[i]);
+    }
+    free(list->chunks);
+    memset(list, 0, sizeof(ListingList));
+}
+
+/**
+ * Fill an empty list from ids already in its order
+ * Returns 0 if out of memory
+ */
+static int fillListingList(ListingList *list, const int *ids, int count) {
+    for (int i = 0; i < count; i += LISTING_CHUNK) {
+        ListingChunk *chunk = addListingChunk(list, list->chunkCount);
+        if (!chunk) {
+            return 0;
+        }
+        chunk->count = count - i < LISTING_CHUNK ? count - i : LISTING_CHUNK;
+        memcpy(chunk->ids, &ids[i], chunk->count * sizeof(int));
+    }
+    return 1;
+}
+
+/**
+ * Store a reservation in a free row and return its id, or -1
+ */
+static int allocateListingRow(const Passenger *p) {
+    ListingIndex *x = &listingIndex;
+    int id;
+    
+    if (x->freeCount > 0) {
+        id = x->freeRows[--x->freeCount];
+    } else {
+        if (x->rowCount == x->rowCap) {
+            int newCap = x->rowCap ? x->rowCap * 2 : 1024;
+            Passenger *grown = realloc(x->rows, newCap * sizeof(Passenger));
+            if (!grown) {
+                return -1;
+            }
+            x->rows = grown;
+            x->rowCap = newCap;
+        }
+        id = x->rowCount++;
+    }
+    x->rows[id] = *p;
+    return id;
+}
+
+/**
+ * Add a reservation to the index
+ * Returns 0 if out of memory; the row may then be in one order only, so the
+ * caller must drop the index
+ */
+static int listingAdd(const Passenger *p) {
+    int id = allocateListingRow(p);
+    if (id < 0) {
+        return 0;
+    }
+    int part = listingPartition(p);
+    return listingInsert(&listingIndex.byFlight[part], LISTING_ORDER_FLIGHT, id) &&
+           listingInsert(&listingIndex.byName[part], LISTING_ORDER_NAME, id);
+}
+
+/**
+ * Remove a row from the index
+ */
+static void listingRemove(int id) {
+    ListingIndex *x = &listingIndex;
+    int part = listingPartition(&x->rows[id]);
+    listingErase(&x->byFlight[part], LISTING_ORDER_FLIGHT, id);
+    listingErase(&x->byName[part], LISTING_ORDER_NAME, id);
+    
+    appendInt(&x->freeRows, &x->freeCount, &x->freeCap, id);  // Else the row is not reused
+}
+
+/**
+ * Row id of the active reservation for a PNR on a flight, or -1
+ */
+static int findListingRow(int flightNumber, const char *pnr) {
+    Passenger key;
+    memset(&key, 0, sizeof(key));
+    key.flightNumber = flightNumber;
+    snprintf(key.pnr, sizeof(key.pnr), "%s", pnr);
+    
+    for (int payment = 0; payment < 4; payment++) {
+        const ListingList *list = &listingIndex.byFlight[4 + payment];
+        int id = listingAt(list, listingSeek(list, LISTING_ORDER_FLIGHT, &key, 0));
+        if (id >= 0 && listingIndex.rows[id].flightNumber == flightNumber &&
+            strcmp(listingIndex.rows[id].pnr, key.pnr) == 0) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Apply one logged reservation change to the index
+ * Returns 0 if out of memory
+ */
+static int applyListingChange(const ChangeRecord *change) {
+    const Passenger *p = &change->passenger;
+    int id;
+    
+    switch (change->type) {
+        case CHANGE_RESERVATION_APPEND:
+            return listingAdd(p);
+        case CHANGE_RESERVATION_REPLACE:
+        case CHANGE_RESERVATION_REMOVE:
+            if ((id = findListingRow(p->flightNumber, p->pnr)) >= 0) {
+                listingRemove(id);
+            }
+            if (change->type == CHANGE_RESERVATION_REPLACE) {
+                return listingAdd(p);
+            }
+            break;
+    }
+    return 1;
+}
+
+/**
+ * Collect one snapshot record while building the index
+ * Stops the scan if out of memory
+ */
+static int collectListingRow(const Passenger *p, void *arg) {
+    ListingBuild *build = arg;
+    int id = allocateListingRow(p);
+    int part = listingPartition(p);
+    build->failed = id < 0 ||
+                    !appendInt(&build->ids[part], &build->count[part], &build->cap[part], id) ||
+                    !appendInt(&build->ids[LISTING_PARTITIONS + part], &build->count[LISTING_PARTITIONS + part],
+                               &build->cap[LISTING_PARTITIONS + part], id);
+    return !build->failed;
+}
+
+/**
+ * Free the index's rows and lists, leaving it unbuilt
+ */
+static void freeListingIndex() {
+    ListingIndex *x = &listingIndex;
+    for (int i = 0; i < LISTING_PARTITIONS; i++) {
+        freeListingList(&x->byFlight[i]);
+        freeListingList(&x->byName[i]);
+    }
+    free(x->rows);
+    free(x->freeRows);
+    memset(x, 0, sizeof(ListingIndex));
+}
+
+/**
+ * Build the index from a snapshot, sorting each list once
+ */
+static int buildListingIndex(ReservationEngine *engine) {
+    ListingIndex *x = &listingIndex;
+    EngineSnapshot snapshot;
+    ListingBuild build;
+    
+    freeListingIndex();
+    if (takeSnapshot(engine, &snapshot, 0) != ENGINE_OK) {
+        return 0;
+    }
+    memset(&build, 0, sizeof(build));
+    long scanned = engineScanSnapshot(&snapshot, collectListingRow, &build);
+    x->logPosition = snapshot.sequence;
+    engineCloseSnapshot(&snapshot);
+    
+    int ok = scanned >= 0 && !build.failed;
+    for (int i = 0; i < LISTING_PARTITIONS; i++) {
+        if (ok) {
+            listingSortOrder = LISTING_ORDER_FLIGHT;
+            qsort(build.ids[i], build.count[i], sizeof(int), compareListingIds);
+            listingSortOrder = LISTING_ORDER_NAME;
+            qsort(build.ids[LISTING_PARTITIONS + i], build.count[LISTING_PARTITIONS + i], sizeof(int),
+                  compareListingIds);
+            ok = fillListingList(&x->byFlight[i], build.ids[i], build.count[i]) &&
+                 fillListingList(&x->byName[i], build.ids[LISTING_PARTITIONS + i],
+                                 build.count[LISTING_PARTITIONS + i]);
+        }
+        free(build.ids[i]);
+        free(build.ids[LISTING_PARTITIONS + i]);
+    }
+    if (!ok) {
+        freeListingIndex();
+        return 0;  // Left unbuilt; the next listing tries again
+    }
+    x->built = 1;
+    return 1;
+}
+
+/**
+ * Build the index on first use, then replay reservation changes logged since
+ * A follower only replays what it has applied to its own files
+ */
+static int refreshListingIndex(ReservationEngine *engine) {
+    ListingIndex *x = &listingIndex;
+    long long records, logId;
+    FILE *log = openChangeLog(followLogDir[0] ? followLogDir : changeLogDir, &records, &logId);
+    long long limit = followLogDir[0] && replicaApplied < records ? replicaApplied : records;
+    
+    if (!log && !followLogDir[0]) {
+        x->built = 0;  // Nothing to replay, so only a fresh snapshot is current
+    }
+    if (x->built && (records < x->logPosition || logId != x->logId)) {
+        x->built = 0;  // The log was reset; start over from a snapshot
+    }
+    if (!x->built) {
+        if (!buildListingIndex(engine)) {
+            if (log) {
+                fclose(log);
+            }
+            return 0;
+        }
+        x->logId = logId;
+    }
+    
+    if (log && x->logPosition < limit) {
+        ChangeRecord *batch = malloc(CHANGE_LOG_BATCH * sizeof(ChangeRecord));
+        size_t n;
+        fseek(log, (long)(x->logPosition * sizeof(ChangeRecord)), SEEK_SET);
+        while (batch && x->logPosition < limit &&
+               (n = fread(batch, sizeof(ChangeRecord), CHANGE_LOG_BATCH, log)) > 0) {
+            for (size_t i = 0; i < n && x->logPosition < limit; i++) {
+                if (!applyListingChange(&batch[i])) {
+                    freeListingIndex();  // Out of memory; rebuilt by the next listing
+                    fclose(log);
+                    free(batch);
+                    return 0;
+                }
+                x->logPosition = batch[i].sequence;
+            }
+        }
+        free(batch);
+    }
+    
+    if (log) {
+        fclose(log);
+    }
+    return 1;
+}
+
+/**
+ * Hash of a listing filter, so a cursor is only accepted by the same filter
+ */
+static unsigned int listingFilterHash(const ListingFilter *filter) {
+    unsigned int h = 5381;
+    h = h * 33 + (unsigned int)filter->flightNumber;
+    h = h * 33 + (unsigned int)filter->paymentMethod;
+    h = h * 33 + (unsigned int)filter->status;
+    for (const char *c = filter->namePrefix; *c; c++) {
+        h = h * 33 + (unsigned char)tolower((unsigned char)*c);
+    }
+    return h;
+}
+
+/**
+ * Checksum over a cursor's fields (everything before check)
+ */
+static unsigned int listingCursorCheck(const ListingCursor *cursor) {
+    const unsigned char *bytes = (const unsigned char *)cursor;
+    unsigned int h = 5381;
+    for (size_t i = 0; i < offsetof(ListingCursor, check); i++) {
+        h = h * 33 + bytes[i];
+    }
+    return h;
+}
+
+/**
+ * Encode the position after a row as an opaque hex cursor
+ */
+static void encodeListingCursor(int order, unsigned int filterHash, const Passenger *last, char *out) {
+    ListingCursor cursor;
+    memset(&cursor, 0, sizeof(cursor));
+    cursor.version = LISTING_CURSOR_VERSION;
+    cursor.order = (unsigned char)order;
+    cursor.isBooked = last->isBooked;
+    cursor.flightNumber = last->flightNumber;
+    cursor.seatNumber = last->seatNumber;
+    memcpy(cursor.pnr, last->pnr, sizeof(cursor.pnr));
+    if (order == LISTING_ORDER_NAME) {
+        memcpy(cursor.name, last->name, sizeof(cursor.name));
+    }
+    cursor.filterHash = filterHash;
+    cursor.check = listingCursorCheck(&cursor);
+    
+    const unsigned char *bytes = (const unsigned char *)&cursor;
+    for (size_t i = 0; i < sizeof(cursor); i++) {
+        sprintf(out + 2 * i, "%02x", bytes[i]);
+    }
+}
+
+/**
+ * Decode a cursor into the sort key it resumes after
+ */
+static int decodeListingCursor(const char *text, int order, unsigned int filterHash, Passenger *key) {
+    ListingCursor cursor;
+    unsigned char *bytes = (unsigned char *)&cursor;
+    
+    if (strlen(text) != 2 * sizeof(cursor)) {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(cursor); i++) {
+        unsigned int byte;
+        if (!isxdigit((unsigned char)text[2 * i]) || !isxdigit((unsigned char)text[2 * i + 1]) ||
+            sscanf(text + 2 * i, "%2x", &byte) != 1) {
+            return 0;
+        }
+        bytes[i] = (unsigned char)byte;
+    }
+    if (cursor.version != LISTING_CURSOR_VERSION || cursor.order != order ||
+        cursor.filterHash != filterHash || cursor.check != listingCursorCheck(&cursor)) {
+        return 0;
+    }
+    
+    memset(key, 0, sizeof(Passenger));
+    key->isBooked = cursor.isBooked;
+    key->flightNumber = cursor.flightNumber;
+    key->seatNumber = cursor.seatNumber;
+    memcpy(key->pnr, cursor.pnr, sizeof(cursor.pnr));
+    memcpy(key->name, cursor.name, sizeof(cursor.name));
+    key->pnr[PNR_LEN] = '\0';
+    key->name[MAX_NAME_LEN] = '\0';
+    return 1;
+}
+
+/**
+ * List one page of reservations matching a filter
+ * cursor is "" for the first page or the nextCursor of the previous one;
+ * nextCursor is set to "" when there are no more rows
+ */
+int engineListReservations(ReservationEngine *engine, const ListingFilter *filter, const char *cursor,
+                           Passenger *rows, int pageSize, int *count, char *nextCursor) {
+    ListingIndex *x = &listingIndex;
+    
+    *count = 0;
+    nextCursor[0] = '\0';
+    if (pageSize < 1 || pageSize > LISTING_PAGE_MAX ||
+        filter->paymentMethod < 0 || filter->paymentMethod > 4 ||
+        filter->status < EXPORT_STATUS_ACTIVE || filter->status > EXPORT_STATUS_ALL) {
+        return ENGINE_INVALID;
+    }
+    
+    // A flight's rows are few, so a name prefix within one is a residual check
+    int order = filter->flightNumber == 0 && filter->namePrefix[0] ? LISTING_ORDER_NAME
+                                                                   : LISTING_ORDER_FLIGHT;
+    unsigned int filterHash = listingFilterHash(filter);
+    size_t prefixLen = strlen(filter->namePrefix);
+    
+    Passenger start;
+    int after = cursor && cursor[0];
+    if (after) {
+        if (!decodeListingCursor(cursor, order, filterHash, &start)) {
+            return ENGINE_INVALID;
+        }
+    } else {
+        memset(&start, 0, sizeof(start));
+        start.flightNumber = filter->flightNumber;
+        snprintf(start.name, sizeof(start.name), "%s", filter->namePrefix);
+    }
+    
+    if (!refreshListingIndex(engine)) {
+        return ENGINE_ERROR;
+    }
+    
+    // Seek every list the status and payment filters allow
+    ListingList *lists[LISTING_PARTITIONS];
+    ListingPos pos[LISTING_PARTITIONS];
+    int listCount = 0;
+    for (int part = 0; part < LISTING_PARTITIONS; part++) {
+        int booked = part >= 4;
+        if ((filter->status == EXPORT_STATUS_ACTIVE && !booked) ||
+            (filter->status == EXPORT_STATUS_CANCELLED && booked) ||
+            (filter->paymentMethod != 0 && filter->paymentMethod != part % 4 + 1)) {
+            continue;
+        }
+        lists[listCount] = order == LISTING_ORDER_NAME ? &x->byName[part] : &x->byFlight[part];
+        pos[listCount] = listingSeek(lists[listCount], order, &start, after);
+        listCount++;
+    }
+    
+    // Merge the lists in order until the page is full and one more row is found
+    while (1) {
+        int best = -1;
+        const Passenger *row = NULL;
+        for (int l = 0; l < listCount; l++) {
+            int id = listingAt(lists[l], pos[l]);
+            if (id < 0) {
+                continue;
+            }
+            const Passenger *p = &x->rows[id];
+            if ((filter->flightNumber != 0 && p->flightNumber != filter->flightNumber) ||
+                (order == LISTING_ORDER_NAME && strncasecmp(p->name, filter->namePrefix, prefixLen) != 0)) {
+                pos[l].chunk = lists[l]->chunkCount;  // Sorted, so nothing further matches
+                continue;
+            }
+            if (!row || compareListing(order, p, row) < 0) {
+                best = l;
+                row = p;
+            }
+        }
+        if (!row) {
+            break;
+        }
+        listingNext(lists[best], &pos[best]);
+        
+        if (order == LISTING_ORDER_FLIGHT && strncasecmp(row->name, filter->namePrefix, prefixLen) != 0) {
+            continue;
+        }
+        if (*count == pageSize) {
+            encodeListingCursor(order, filterHash, &rows[*count - 1], nextCursor);
+            break;
+        }
+        rows[(*count)++] = *row;
+    }
+    return ENGINE_OK;
+}
+
+/* ================ READ REPLICA ================ */
+
+/*
+ * A follower (started with --follow=DIR) keeps its own copy of the data in
+ * its working directory. Before each read-only query it replays the change
+ * log records it has not yet applied, then answers from its own files.
+ * Replication lag is how long ago the oldest unapplied record was
+ * committed on the primary, measured before catching up; it is 0 when the
+ * follower is current.
+ */
+
+static long long replicaAppliedCommit = 0; // Primary commit time of that record
+static long long replicaPrimarySequence = 0;
+static long long replicaLagSeconds = 0;
+
+/**
+ * Create the log directory and seed an empty log with the current state
+ */
+static void initializeChangeLog(ReservationEngine *engine) {
+    char path[EXPORT_PATH_LEN + 32];
+    struct stat st;
+    
+    if (mkdir(changeLogDir, 0755) != 0 && errno != EEXIST) {
+        engineLog("Warning: Could not create change log directory %s.", changeLogDir);
+        return;
+    }
+    
+    changeLogPath(changeLogDir, path, sizeof(path));
+    if (stat(path, &st) == 0 && st.st_size > 0) {
+        if (readChangeLogId(changeLogDir) == 0) {
+            writeChangeLogId(changeLogDir);  // Log from before ids were kept
+        }
+        return;
+    }
+    writeChangeLogId(changeLogDir);
+    
+    ChangeRecord *batch = calloc(CHANGE_LOG_BATCH, sizeof(ChangeRecord));
+    int pending = 0;
+    if (!batch) {
+        return;
+    }
+    
+    beginCommit();  // Snapshots see the data either before or after seeding
+    syncFlights(engine);
+    for (int i = 0; i < engine->flightCount; i++) {
+        memset(&batch[pending], 0, sizeof(ChangeRecord));
+        batch[pending].type = CHANGE_FLIGHT_PUT;
+        batch[pending].flags = CHANGE_FLAG_SNAPSHOT;
+        batch[pending].flight = engine->flights[i];
+        if (++pending == CHANGE_LOG_BATCH) {
+            logChanges(batch, pending);
+            pending = 0;
+        }
+    }
+    
+    DIR *dir = opendir(SEGMENT_DIR);
+    int flightNumber;
+    FILE *fp;
+    while ((fp = openNextSegment(dir, &flightNumber)) != NULL) {
+        Passenger p;
+        while (fread(&p, sizeof(Passenger), 1, fp) == 1) {
+            memset(&batch[pending], 0, sizeof(ChangeRecord));
+            batch[pending].type = CHANGE_RESERVATION_APPEND;
+            batch[pending].flags = CHANGE_FLAG_SNAPSHOT;
+            batch[pending].passenger = p;
+            if (++pending == CHANGE_LOG_BATCH) {
+                logChanges(batch, pending);
+                pending = 0;
+            }
+        }
+        fclose(fp);
+    }
+    if (dir) {
+        closedir(dir);
+    }
+    
+    logChanges(batch, pending);
+    endCommit();
+    free(batch);
+}
+
+/**
+ * Replay one change record against the local copy
+ */
+static void applyChange(ReservationEngine *engine, const ChangeRecord *change) {
+    const Passenger *p = &change->passenger;
+    
+    switch (change->type) {
+        case CHANGE_RESERVATION_APPEND:
+            appendReservation(p);
+            break;
+        case CHANGE_RESERVATION_REPLACE:
+            replaceReservation(p->flightNumber, p->pnr, p);
+            break;
+        case CHANGE_RESERVATION_REMOVE:
+            replaceReservation(p->flightNumber, p->pnr, NULL);
+            break;
+        case CHANGE_FLIGHT_PUT:
+            putFlight(engine, &change->flight);
+            break;
+        case CHANGE_FLIGHT_DELETE:
+            removeFlight(engine, change->flight.flightNumber, NULL);
+            break;
+        case CHANGE_FLIGHT_ARCHIVE:
+            archiveFlight(change->flight.flightNumber);
+            break;
+    }
+}
+
+/**
+ * Hold back a new flight from a change record so a run of them is appended
+ * together; a bulk-loaded schedule then costs one reload, not one per flight
+ * Returns 0 if the record is not a new flight and must go to applyChange
+ */
+static int queueFlightAdd(ReservationEngine *engine, const ChangeRecord *change,
+                          Flight *added, int *addedCount) {
+    if (!added || change->type != CHANGE_FLIGHT_PUT ||
+        flightIndex(engine, change->flight.flightNumber) >= 0) {
+        return 0;
+    }
+    for (int i = 0; i < *addedCount; i++) {
+        if (added[i].flightNumber == change->flight.flightNumber) {
+            return 0;
+        }
+    }
+    added[(*addedCount)++] = change->flight;
+    return 1;
+}
+
+/**
+ * Append the new flights held back by queueFlightAdd
+ */
+static void flushFlightAdds(ReservationEngine *engine, Flight *added, int *addedCount) {
+    if (*addedCount > 0) {
+        appendFlights(engine, added, *addedCount, NULL);
+        *addedCount = 0;
+    }
+}
+
+/**
+ * Save the replay position so a restarted follower resumes where it stopped
+ * The replayed data is synced first and then the state file, before it is
+ * renamed into place, so after a crash the position does not claim records
+ * whose data was lost
+ * Returns 0 if the data or the position could not be made durable
+ */
+static int saveReplicaState() {
+    // Segments, flights, series and archives all live in the working directory
+#ifdef SYS_syncfs
+    int fd = open(".", O_RDONLY | O_DIRECTORY);
+    int synced = fd >= 0 && syscall(SYS_syncfs, fd) == 0;
+    if (fd >= 0) {
+        close(fd);
+    }
+#else
+    sync();  // Every file system; waits for the writes on Linux
+    int synced = 1;
+#endif
+    
+    // Saved even if the sync failed: the data is applied, and replaying it
+    // again after a clean restart would duplicate it
+    FILE *fp = fopen(REPLICA_STATE_TEMP, "wb");
+    if (!fp) {
+        return 0;
+    }
+    int ok = fwrite(&replicaApplied, sizeof(replicaApplied), 1, fp) == 1 &&
+             fwrite(&replicaAppliedCommit, sizeof(replicaAppliedCommit), 1, fp) == 1 &&
+             fwrite(&replicaLogId, sizeof(replicaLogId), 1, fp) == 1 &&
+             fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    if (fclose(fp) != 0) {
+        ok = 0;
+    }
+    if (!ok || rename(REPLICA_STATE_TEMP, REPLICA_STATE_FILE) != 0) {
+        remove(REPLICA_STATE_TEMP);
+        return 0;
+    }
+    return synced && syncDirectory(".");
+}
+
+/**
+ * Load the replay position saved by a previous run
+ */
+static void loadReplicaState() {
+    FILE *fp = fopen(REPLICA_STATE_FILE, "rb");
+    if (!fp) {
+        return;
+    }
+    if (fread(&replicaApplied, sizeof(replicaApplied), 1, fp) != 1 ||
+        fread(&replicaAppliedCommit, sizeof(replicaAppliedCommit), 1, fp) != 1) {
+        replicaApplied = 0;
+        replicaAppliedCommit = 0;
+    }
+    if (fread(&replicaLogId, sizeof(replicaLogId), 1, fp) != 1) {
+        replicaLogId = 0;  // Saved before log ids were kept
+    }
+    fclose(fp);
+}
+
+/**
+ * Measure how far the follower is behind without applying anything
+ */
+static void measureReplicationLag() {
+    char path[EXPORT_PATH_LEN + 32];
+    changeLogPath(followLogDir, path, sizeof(path));
+    
+    replicaLagSeconds = 0;
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return;
+    }
+    
+    fseek(fp, 0, SEEK_END);
+    replicaPrimarySequence = ftell(fp) / (long)sizeof(ChangeRecord);
+    
+    // Lag is the age of the oldest change not applied yet
+    ChangeRecord next;
+    fseek(fp, (long)(replicaApplied * sizeof(ChangeRecord)), SEEK_SET);
+    if (fread(&next, sizeof(ChangeRecord), 1, fp) == 1) {
+        replicaLagSeconds = (long long)time(NULL) - next.timestamp;
+    }
+    fclose(fp);
+}
+
+/**
+ * Apply all change log records the follower has not seen yet
+ * Returns the number of records applied, or -1 if the primary's log was
+ * reset (data upgrade) and this replica must be rebuilt
+ */
+static long catchUpReplica(ReservationEngine *engine) {
+    long long records, logId;
+    FILE *fp = openChangeLog(followLogDir, &records, &logId);
+    if (!fp) {
+        return 0;
+    }
+    
+    if (records < replicaApplied || (replicaLogId != 0 && logId != replicaLogId)) {
+        fclose(fp);
+        return -1;
+    }
+    replicaLogId = logId;
+    
+    // Records are fixed size, so the next unapplied one is found by offset
+    ChangeRecord *batch = malloc(CHANGE_LOG_BATCH * sizeof(ChangeRecord));
+    Flight *added = malloc(CHANGE_LOG_BATCH * sizeof(Flight));
+    int addedCount = 0;
+    long applied = 0;
+    size_t n;
+    
+    fseek(fp, (long)(replicaApplied * sizeof(ChangeRecord)), SEEK_SET);
+    beginCommit();  // Snapshots see the replica before or after the whole catch-up
+    syncFlights(engine);
+    while (batch && (n = fread(batch, sizeof(ChangeRecord), CHANGE_LOG_BATCH, fp)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            replicaApplied = batch[i].sequence;
+            replicaAppliedCommit = batch[i].timestamp;
+            if (queueFlightAdd(engine, &batch[i], added, &addedCount)) {
+                continue;
+            }
+            flushFlightAdds(engine, added, &addedCount);
+            
+            // Events are recorded when the primary made them; seeded and imported ones on their PNR date
+            seriesClock = batch[i].timestamp;
+            if (batch[i].flags & (CHANGE_FLAG_SNAPSHOT | CHANGE_FLAG_IMPORTED)) {
+                time_t bookedAt = pnrBookingTime(batch[i].passenger.pnr);
+                if (bookedAt) {
+                    seriesClock = bookedAt;
+                } else if (batch[i].flags & CHANGE_FLAG_SNAPSHOT) {
+                    seriesClock = -1;  // Not backfilled on the primary either
+                }
+            }
+            applyChange(engine, &batch[i]);
+            seriesClock = 0;
+        }
+        flushFlightAdds(engine, added, &addedCount);
+        applied += (long)n;
+        if (!saveReplicaState()) {
+            engineLog("Warning: Could not save the replica position in %s.", REPLICA_STATE_FILE);
+        }
+    }
+    endCommit();
+    
+    replicaPrimarySequence = replicaApplied;
+    replicaLagSeconds = 0;
+    
+    free(added);
+    free(batch);
+    fclose(fp);
+    return applied;
+}
+
+/* ================ ENGINE API ================ */
+
+/*
+ * Non-interactive entry points used by the menu client and by programs
+ * embedding the engine. Calls return ENGINE_OK or an ENGINE_* status and
+ * fill in the caller's structures; none of them read from the terminal.
+ */
+
+/**
+ * Describe an ENGINE_* status for messages
+ */
+const char *engineStatusText(int status) {
+    switch (status) {
+        case ENGINE_OK: return "OK";
+        case ENGINE_ERROR: return "could not read or write the data files";
+        case ENGINE_NO_FLIGHT: return "no such flight";
+        case ENGINE_FLIGHT_FULL: return "flight is full";
+        case ENGINE_FLIGHT_EXISTS: return "flight number already exists";
+        case ENGINE_SEAT_TAKEN: return "seat is already booked";
+        case ENGINE_SEAT_HELD: return "seat is being booked by someone else";
+        case ENGINE_HOLD_EXPIRED: return "seat hold has expired";
+        case ENGINE_NOT_FOUND: return "PNR not found or booking cancelled";
+        case ENGINE_INVALID: return "invalid request";
+        case ENGINE_READ_ONLY: return "read-only replica";
+        case ENGINE_ARCHIVED: return "flight has departed and its bookings are archived";
+        default: return "unknown error";
+    }
+}
+
+typedef struct {
+    int flightNumber;                 // Run of records being collected, 0 = none
+    int hour;
+    int booked;
+    int cancelled;
+} SeriesBackfill;
+
+/**
+ * Collect one existing reservation into the time series on its PNR date
+ */
+static int backfillSeriesRecord(const Passenger *p, void *arg) {
+    SeriesBackfill *run = arg;
+    time_t bookedAt = pnrBookingTime(p->pnr);
+    if (bookedAt == 0) {
+        return 1;  // No booking date to place it at
+    }
+    
+    // Segments hold a flight's records in booking order, so runs are long
+    int hour = (int)(bookedAt / 3600);
+    if (run->flightNumber != p->flightNumber || run->hour != hour || run->booked >= USHRT_MAX) {
+        if (run->flightNumber != 0) {
+            seriesAdd(run->flightNumber, run->hour, run->booked, run->cancelled);
+        }
+        memset(run, 0, sizeof(SeriesBackfill));
+        run->flightNumber = p->flightNumber;
+        run->hour = hour;
+    }
+    run->booked++;
+    run->cancelled += !p->isBooked;
+    return 1;
+}
+
+/**
+ * Create the time series directory, backfilling it from existing reservations
+ * Only the session that creates the directory backfills
+ */
+static void openBookingSeries(ReservationEngine *engine) {
+    if (mkdir(SERIES_DIR, 0755) != 0) {
+        if (errno != EEXIST) {
+            engineLog("Warning: Could not create %s; booking trends are not recorded.", SERIES_DIR);
+        }
+        return;
+    }
+    
+    SeriesBackfill run;
+    memset(&run, 0, sizeof(run));
+    if (engineScanReservations(engine, backfillSeriesRecord, &run) < 0) {
+        engineLog("Warning: Could not read every reservation; booking trends are incomplete.");
+    }
+    if (run.flightNumber != 0) {
+        seriesAdd(run.flightNumber, run.hour, run.booked, run.cancelled);
+    }
+}
+
+/**
+ * Open the data files in the working directory
+ * Creates missing files, upgrades old formats, maps the PNR filter and,
+ * unless following a primary, seeds the change log
+ */
+int engineOpen(ReservationEngine *engine, const EngineOptions *options) {
+    memset(engine, 0, sizeof(ReservationEngine));
+    
+    engineLogger = options->log;
+    if (options->logDir) {
+        snprintf(changeLogDir, sizeof(changeLogDir), "%s", options->logDir);
+    }
+    if (options->followDir) {
+        snprintf(followLogDir, sizeof(followLogDir), "%s", options->followDir);
+    }
+    if (options->storage) {
+        engineSelectStorage(options->storage);
+    }
+    storageSync = options->fsync;
+    seedPnrGenerator();
+    engine->readOnly = followLogDir[0] != '\0';
+    
+    initializeFiles();
+    migrateDataFiles();
+    if (access(PRICING_RULES_FILE, F_OK) == 0) {
+        PricingRules rules;
+        if (loadPricingRules(PRICING_RULES_FILE, &rules)) {
+            pricingRules = rules;
+        } else {
+            engineLog("Warning: Ignoring %s, using built-in pricing rules.", PRICING_RULES_FILE);
+        }
+    }
+    openPnrFilter();
+    
+    if (!loadFlights(engine)) {
+        return ENGINE_ERROR;
+    }
+    
+    if (engine->readOnly) {
+        changeLogEnabled = 0;  // Changes are replayed, not logged again
+        loadReplicaState();
+    } else {
+        initializeChangeLog(engine);
+        migrateLegacyReservations();
+    }
+    openBookingSeries(engine);
+    return ENGINE_OK;
+}
+
+/**
+ * Release this session's seat holds and close the data files
+ */
+void engineClose(ReservationEngine *engine) {
+    releaseAllSeatHolds();
+    if (engine->flightFile) {
+        fclose(engine->flightFile);
+    }
+    free(engine->flights);
+    free(engine->flightSlots);
+    memset(engine, 0, sizeof(ReservationEngine));
+}
+
+/**
+ * Current flights, in file order
+ * Returns the count, or -1 if flights.dat cannot be read; the array is
+ * valid until the next engine call
+ */
+int engineFlights(ReservationEngine *engine, const Flight **flights) {
+    if (!syncFlights(engine)) {
+        return -1;
+    }
+    *flights = engine->flights;
+    return engine->flightCount;
+}
+
+/**
+ * Copy one flight's record
+ */
+int engineFindFlight(ReservationEngine *engine, int flightNumber, Flight *out) {
+    Flight *flight = findFlight(engine, flightNumber);
+    if (!flight) {
+        return ENGINE_NO_FLIGHT;
+    }
+    if (out) {
+        *out = *flight;
+    }
+    return ENGINE_OK;
+}
+
+/**
+ * Add a flight with every seat free, priced from its base fare
+ */
+int engineAddFlight(ReservationEngine *engine, Flight *flight) {
+    if (engine->readOnly) {
+        return ENGINE_READ_ONLY;
+    }
+    if (flight->flightNumber <= 0 || flight->baseFare < 0.0f) {
+        return ENGINE_INVALID;
+    }
+    if (findFlight(engine, flight->flightNumber)) {
+        return ENGINE_FLIGHT_EXISTS;
+    }
+    
+    flight->availableSeats = MAX_SEATS;
+    flight->fareBucket = 0;
+    repriceFlight(flight);
+    
+    // Checked again under the append lock, in case another session added it
+    unsigned char taken = 0;
+    beginCommit();
+    int written = appendFlights(engine, flight, 1, &taken);
+    if (written == 1) {
+        logFlightChange(CHANGE_FLIGHT_PUT, flight);
+    }
+    endCommit();
+    if (written < 0) {
+        return ENGINE_ERROR;
+    }
+    return taken ? ENGINE_FLIGHT_EXISTS : ENGINE_OK;
+}
+
+/**
+ * Delete a flight, returning its last record
+ */
+int engineDeleteFlight(ReservationEngine *engine, int flightNumber, Flight *removed) {
+    Flight flight;
+    
+    if (engine->readOnly) {
+        return ENGINE_READ_ONLY;
+    }
+    beginCommit();
+    int ok = removeFlight(engine, flightNumber, &flight);
+    if (ok) {
+        logFlightChange(CHANGE_FLIGHT_DELETE, &flight);
+    }
+    endCommit();
+    if (!ok) {
+        return ENGINE_NO_FLIGHT;
+    }
+    if (removed) {
+        *removed = flight;
+    }
+    return ENGINE_OK;
+}
+
+/**
+ * Price a seat on a flight right now
+ */
+int engineQuote(ReservationEngine *engine, int flightNumber, float *fare) {
+    Flight *flight = findFlight(engine, flightNumber);
+    if (!flight) {
+        return ENGINE_NO_FLIGHT;
+    }
+    *fare = engineFlightFare(flight);
+    return ENGINE_OK;
+}
+
+/**
+ * Mark the seats booked on a flight (taken[seat - 1] = 1)
+ */
+int engineSeatMap(ReservationEngine *engine, int flightNumber, unsigned char taken[MAX_SEATS]) {
+    if (!findFlight(engine, flightNumber)) {
+        return ENGINE_NO_FLIGHT;
+    }
+    
+    int count;
+    Passenger *records = loadSegment(flightNumber, &count);
+    memset(taken, 0, MAX_SEATS);
+    if (count < 0) {
+        return ENGINE_ERROR;
+    }
+    for (int i = 0; i < count; i++) {
+        if (records[i].isBooked &&
+            records[i].seatNumber >= 1 &&
+            records[i].seatNumber <= MAX_SEATS) {
+            taken[records[i].seatNumber - 1] = 1;
+        }
+    }
+    free(records);
+    return archivedSeatMap(flightNumber, taken) ? ENGINE_OK : ENGINE_ERROR;
+}
+
+/**
+ * Check that a seat is neither booked nor held
+ */
+int engineSeatAvailable(ReservationEngine *engine, int flightNumber, int seatNumber) {
+    return findFlight(engine, flightNumber) != NULL && isSeatAvailable(flightNumber, seatNumber);
+}
+
+/**
+ * Hold a seat for HOLD_TTL_SECONDS while a booking is completed
+ * The fare quoted now (returned in fare, if given) is the one charged when
+ * the booking is made with this hold
+ */
+int engineHoldSeat(ReservationEngine *engine, int flightNumber, int seatNumber, int *hold, float *fare) {
+    if (engine->readOnly) {
+        return ENGINE_READ_ONLY;
+    }
+    Flight *flight = findFlight(engine, flightNumber);
+    if (!flight) {
+        return ENGINE_NO_FLIGHT;
+    }
+    int status = seatStatus(flightNumber, seatNumber);
+    if (status != ENGINE_OK) {
+        return status;
+    }
+    
+    float quote = engineFlightFare(flight);
+    *hold = holdSeat(flightNumber, seatNumber, quote);
+    if (*hold < 0) {
+        return ENGINE_SEAT_HELD;
+    }
+    if (fare) {
+        *fare = quote;
+    }
+    return ENGINE_OK;
+}
+
+/**
+ * Give up a seat hold without booking
+ */
+void engineReleaseHold(int hold) {
+    releaseSeatHold(hold);
+}
+
+/**
+ * Book a seat, locking in the fare
+ * The fare charged is the one engineHoldSeat quoted for the request's hold
+ * if the request carries it; otherwise the seat is priced at commit time
+ */
+int engineBook(ReservationEngine *engine, const BookingRequest *request, Passenger *booked) {
+    if (engine->readOnly) {
+        return ENGINE_READ_ONLY;
+    }
+    if (request->name[0] == '\0' || request->age < 1 || request->age > 120 ||
+        (request->gender != 'M' && request->gender != 'F') ||
+        request->seatNumber < 1 || request->seatNumber > MAX_SEATS ||
+        request->paymentMethod < 1 || request->paymentMethod > 4) {
+        return ENGINE_INVALID;
+    }
+    
+    Flight *flight = findFlight(engine, request->flightNumber);
+    if (!flight) {
+        return ENGINE_NO_FLIGHT;
+    }
+    if (flight->availableSeats <= 0) {
+        return ENGINE_FLIGHT_FULL;
+    }
+    
+    // A hold reserves the seat; without one it must be free right now
+    float heldFare = 0.0f;
+    if (request->hold >= 0) {
+        if (!isSeatHoldFor(request->hold, request->flightNumber, request->seatNumber)) {
+            return ENGINE_HOLD_EXPIRED;
+        }
+        heldFare = lookupSeatHold(request->hold)->fare;
+    } else {
+        int status = seatStatus(request->flightNumber, request->seatNumber);
+        if (status != ENGINE_OK) {
+            return status;
+        }
+    }
+    
+    Passenger p;
+    memset(&p, 0, sizeof(Passenger));
+    snprintf(p.name, sizeof(p.name), "%s", request->name);
+    p.age = request->age;
+    p.gender = request->gender;
+    p.seatNumber = request->seatNumber;
+    p.flightNumber = request->flightNumber;
+    p.paymentMethod = request->paymentMethod;
+    p.isBooked = 1;
+    
+    // The record and the seat count change become visible together
+    beginCommit();
+    flight = findFlight(engine, p.flightNumber);
+    int status = flight ? issuePNR(p.pnr) : ENGINE_NO_FLIGHT;
+    if (status == ENGINE_OK) {
+        // A caller's fare stands only if it is the quote issued with its hold
+        p.fare = heldFare > 0.0f && request->fare == heldFare ? heldFare : engineFlightFare(flight);
+        status = appendBooking(&p);
+    }
+    if (status == ENGINE_OK) {
+        updateFlightSeats(engine, p.flightNumber, -1);
+    }
+    endCommit();
+    if (request->hold >= 0) {
+        releaseSeatHold(request->hold);  // The reservation record now owns the seat
+    }
+    if (status != ENGINE_OK) {
+        return status;
+    }
+    
+    if (booked) {
+        *booked = p;
+    }
+    return ENGINE_OK;
+}
+
+/**
+ * Find an active reservation by PNR
+ * Returns ENGINE_OK if it is in a hot segment, ENGINE_ARCHIVED if it is in
+ * the archive, ENGINE_NOT_FOUND, or ENGINE_ERROR if it could not be read
+ */
+static int locateReservation(const char *pnr, Passenger *out) {
+    int found = findReservation(pnr, out);
+    if (found == 0) {
+        found = findArchivedReservation(pnr, out);
+        if (found > 0) {
+            return ENGINE_ARCHIVED;
+        }
+    }
+    return found > 0 ? ENGINE_OK : found == 0 ? ENGINE_NOT_FOUND : ENGINE_ERROR;
+}
+
+/**
+ * Cancel a booking; the record stays in its segment marked cancelled
+ */
+int engineCancel(ReservationEngine *engine, const char *pnr, Passenger *cancelled) {
+    Passenger p;
+    
+    if (engine->readOnly) {
+        return ENGINE_READ_ONLY;
+    }
+    int status = locateReservation(pnr, &p);
+    if (status != ENGINE_OK) {
+        return status;
+    }
+    
+    p.isBooked = 0;
+    beginCommit();
+    int replaced = replaceReservation(p.flightNumber, pnr, &p);
+    if (replaced > 0) {
+        updateFlightSeats(engine, p.flightNumber, 1);
+    }
+    endCommit();
+    if (replaced <= 0) {
+        return replaced == 0 ? ENGINE_NOT_FOUND : ENGINE_ERROR;
+    }
+    
+    if (cancelled) {
+        *cancelled = p;
+    }
+    return ENGINE_OK;
+}
+
+/**
+ * Change a booking's passenger details, flight, seat or payment method
+ * changes is a full copy of the reservation with the new values; moving to
+ * another flight reprices the ticket at that flight's current fare
+ */
+int engineModify(ReservationEngine *engine, const char *pnr, const Passenger *changes, Passenger *result) {
+    Passenger current;
+    
+    if (engine->readOnly) {
+        return ENGINE_READ_ONLY;
+    }
+    int found = locateReservation(pnr, &current);
+    if (found != ENGINE_OK) {
+        return found;
+    }
+    if (changes->name[0] == '\0' || changes->age < 1 || changes->age > 120 ||
+        (changes->gender != 'M' && changes->gender != 'F') ||
+        changes->paymentMethod < 1 || changes->paymentMethod > 4) {
+        return ENGINE_INVALID;
+    }
+    
+    Passenger p = current;
+    snprintf(p.name, sizeof(p.name), "%s", changes->name);
+    p.age = changes->age;
+    p.gender = changes->gender;
+    p.paymentMethod = changes->paymentMethod;
+    
+    if (changes->flightNumber != current.flightNumber) {
+        Flight *flight = findFlight(engine, changes->flightNumber);
+        if (!flight) {
+            return ENGINE_NO_FLIGHT;
+        }
+        if (flight->availableSeats <= 0) {
+            return ENGINE_FLIGHT_FULL;
+        }
+        p.flightNumber = changes->flightNumber;
+        p.fare = engineFlightFare(flight);
+    }
+    if (p.flightNumber != current.flightNumber || changes->seatNumber != current.seatNumber) {
+        int status = seatStatus(p.flightNumber, changes->seatNumber);
+        if (status != ENGINE_OK) {
+            return status;
+        }
+        p.seatNumber = changes->seatNumber;
+    }
+    
+    // A snapshot sees the reservation on exactly one flight
+    int status = ENGINE_OK;
+    beginCommit();
+    if (p.flightNumber != current.flightNumber) {
+        // The record moves to the new flight's segment
+        int removed = replaceReservation(current.flightNumber, pnr, NULL);
+        if (removed <= 0) {
+            status = removed == 0 ? ENGINE_NOT_FOUND : ENGINE_ERROR;
+        } else if ((status = appendBooking(&p)) != ENGINE_OK) {
+            appendReservation(&current);  // Put the original back
+        } else {
+            updateFlightSeats(engine, current.flightNumber, 1);
+            updateFlightSeats(engine, p.flightNumber, -1);
+        }
+    } else if (p.seatNumber != current.seatNumber) {
+        status = replaceBookingSeat(pnr, &p);
+    } else {
+        int replaced = replaceReservation(p.flightNumber, pnr, &p);
+        if (replaced <= 0) {
+            status = replaced == 0 ? ENGINE_NOT_FOUND : ENGINE_ERROR;
+        }
+    }
+    endCommit();
+    if (status != ENGINE_OK) {
+        return status;
+    }
+    
+    if (result) {
+        *result = p;
+    }
+    return ENGINE_OK;
+}
+
+/**
+ * Look up an active reservation by PNR, in the hot segments or the archive
+ */
+int engineLookup(ReservationEngine *engine, const char *pnr, Passenger *out) {
+    (void)engine;  // Reservations are routed through the PNR index
+    int status = locateReservation(pnr, out);
+    return status == ENGINE_ARCHIVED ? ENGINE_OK : status;
+}
+
+/**
+ * Visit every reservation record, active or cancelled, as of one snapshot
+ * Stops early when visit returns 0; returns the number of records visited,
+ * or -1 if the reservations could not be read
+ */
+long engineScanReservations(ReservationEngine *engine,
+                            int (*visit)(const Passenger *p, void *arg), void *arg) {
+    EngineSnapshot snapshot;
+    if (engineOpenSnapshot(engine, &snapshot) != ENGINE_OK) {
+        return -1;
+    }
+    
+    long visited = engineScanSnapshot(&snapshot, visit, arg);
+    engineCloseSnapshot(&snapshot);
+    return visited;
+}
+
+/**
+ * Add one reservation to a report
+ */
+static int addToReport(const Passenger *p, void *arg) {
+    EngineReport *report = arg;
+    if (p->isBooked) {
+        report->activeBookings++;
+        report->revenue += p->fare;
+    } else {
+        report->cancelledBookings++;
+    }
+    return 1;
+}
+
+/**
+ * Booking and revenue totals
+ */
+int engineReport(ReservationEngine *engine, EngineReport *report) {
+    EngineSnapshot snapshot;
+    
+    memset(report, 0, sizeof(EngineReport));
+    if (engineOpenSnapshot(engine, &snapshot) != ENGINE_OK) {
+        return ENGINE_ERROR;
+    }
+    
+    report->flights = snapshot.flightCount;
+    report->sequence = snapshot.sequence;
+    long scanned = scanSnapshotColumns(&snapshot, 1 << ARCHIVE_COL_FARE | 1 << ARCHIVE_COL_STATUS,
+                                       addToReport, report);
+    engineCloseSnapshot(&snapshot);
+    if (scanned < 0) {
+        return ENGINE_ERROR;  // Partial totals would look like real ones
+    }
+    if (report->activeBookings > 0) {
+        report->averageFare = report->revenue / report->activeBookings;
+    }
+    return ENGINE_OK;
+}
+
+/**
+ * Storage backend and PNR filter statistics
+ */
+void engineStats(ReservationEngine *engine, EngineStats *stats) {
+    (void)engine;
+    memset(stats, 0, sizeof(EngineStats));
+    stats->storage = storage->name;
+    stats->fsync = storageSync;
+    pnrFilterStats(stats);
+    archiveStats(stats);
+}
+
+/**
+ * Booking curve of a flight: bookings, cancellations and seats sold per window
+ */
+int engineBookingCurve(ReservationEngine *engine, int flightNumber, int windowHours,
+                       SeriesPoint *points, int maxPoints, int *count) {
+    (void)engine;  // Read from the flight's time series
+    *count = 0;
+    if (flightNumber <= 0 || windowHours < 1 || maxPoints < 1) {
+        return ENGINE_INVALID;
+    }
+    return seriesCurve(flightNumber, windowHours, points, maxPoints, count) ? ENGINE_OK : ENGINE_ERROR;
+}
+
+/**
+ * Bookings, cancellations and daily rates between two times
+ * flightNumber 0 adds up every flight's series
+ */
+int engineRateOfSale(ReservationEngine *engine, int flightNumber, time_t from, time_t to, SalesRate *rate) {
+    (void)engine;
+    memset(rate, 0, sizeof(SalesRate));
+    if (flightNumber < 0 || to <= from) {
+        return ENGINE_INVALID;
+    }
+    
+    int ok = 1;
+    if (flightNumber != 0) {
+        ok = addSeriesRate(flightNumber, from, to, rate);
+    } else {
+        DIR *dir = opendir(SERIES_DIR);
+        struct dirent *entry;
+        int seriesFlight;
+        char suffix[8];
+        while (dir && (entry = readdir(dir)) != NULL) {
+            if (sscanf(entry->d_name, "ts_%d.%7s", &seriesFlight, suffix) == 2 && strcmp(suffix, "dat") == 0) {
+                ok &= addSeriesRate(seriesFlight, from, to, rate);
+            }
+        }
+        if (dir) {
+            closedir(dir);
+        }
+    }
+    
+    double days = (double)(to - from) / 86400.0;
+    rate->bookedPerDay = rate->booked / days;
+    rate->netPerDay = (rate->booked - rate->cancelled) / days;
+    return ok ? ENGINE_OK : ENGINE_ERROR;
+}
+
+/**
+ * Move the reservations of every departed flight to the archive tier
+ */
+int engineArchiveDeparted(ReservationEngine *engine, int *flights, long *records) {
+    long now = (long)(time(NULL) / 60);
+    
+    *flights = 0;
+    *records = 0;
+    if (engine->readOnly) {
+        return ENGINE_READ_ONLY;
+    }
+    if (!syncFlights(engine)) {
+        return ENGINE_ERROR;
+    }
+    
+    int status = ENGINE_OK;
+    for (int i = 0; i < engine->flightCount; i++) {
+        long departs = engineDepartureMinutes(&engine->flights[i]);
+        if (departs < 0 || departs > now) {
+            continue;  // Undated or still to depart
+        }
+        
+        int moved = archiveFlight(engine->flights[i].flightNumber);
+        if (moved < 0) {
+            status = ENGINE_ERROR;
+        } else if (moved > 0) {
+            (*flights)++;
+            *records += moved;
+        }
+    }
+    return status;
+}
+
+/**
+ * Replay the primary's changes this follower has not applied yet
+ * Returns the number applied, or -1 if the primary's log was reset
+ */
+long engineCatchUp(ReservationEngine *engine) {
+    return engine->readOnly ? catchUpReplica(engine) : 0;
+}
+
+/**
+ * How far this follower is behind its primary
+ */
+void engineReplicaStatus(ReservationEngine *engine, ReplicaStatus *status) {
+    memset(status, 0, sizeof(ReplicaStatus));
+    if (!engine->readOnly) {
+        return;
+    }
+    
+    measureReplicationLag();
+    status->followDir = followLogDir;
+    status->appliedSequence = replicaApplied;
+    status->primarySequence = replicaPrimarySequence;
+    status->lagSeconds = replicaLagSeconds;
+    status->appliedCommit = replicaAppliedCommit;
+}
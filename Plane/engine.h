@@ -0,0 +1,274 @@
+/*
+ * Reservation engine: flights, reservations, pricing, change log and
+ * replication for the airline reservation system, with no terminal I/O:
+ * warnings go to the EngineOptions log callback and reports to a FILE the
+ * caller passes in. plane.c is the menu client; other programs can link
+ * engine.c and drive the same data through the calls below.
+ *
+ * A ReservationEngine holds the open flights file and an in-memory copy of
+ * the flights, so lookups and seat updates no longer open and scan
+ * flights.dat on every call. Another session's changes are picked up by
+ * re-reading the open file whenever its identity, size or modification
+ * time says it may have changed.
+ *
+ * Process-wide state (storage backend, PNR filter mapping, seat hold table,
+ * change log location, listing index, route graph, replica position) is set
+ * up by the first engineOpen; open one engine per process. Every engine*
+ * call that reads or writes engine data takes the engine, even those served
+ * only from process-wide state (engineLookup, engineStats,
+ * engineBookingCurve, engineRateOfSale), so callers need not tell them
+ * apart. The calls that take no engine (engineReleaseHold, the fare and
+ * date helpers, storage selection and benchmark, pricing replay) use only
+ * process-wide state or none.
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+
+#define MAX_SEATS 100
+#define MAX_NAME_LEN 49
+#define MAX_DEST_LEN 49
+#define MAX_TIME_LEN 9
+#define MAX_DATE_LEN 10                   // YYYY-MM-DD
+#define PNR_LEN 10                        // YYMMDD + 4 random digits
+
+#define HOLD_TTL_SECONDS 300              // How long a chosen seat stays reserved
+
+#define EXPORT_FORMAT_CSV 1
+#define EXPORT_FORMAT_NDJSON 2
+#define EXPORT_STATUS_ACTIVE 1
+#define EXPORT_STATUS_CANCELLED 2
+#define EXPORT_STATUS_ALL 3
+#define EXPORT_PATH_LEN 255
+#define IMPORT_REPORT_LIMIT 20            // Rejected rows listed individually
+
+#define CHANGE_LOG_DIR "changelog"        // Default log directory (--log-dir)
+
+#define LISTING_PAGE_MAX 100              // Most rows one listing page returns
+#define LISTING_CURSOR_LEN 192            // Hex characters in a listing cursor
+
+#define ITINERARY_MAX_LEGS 3              // Direct, one or two stops
+#define ITINERARY_RESULTS 5
+
+#define ENGINE_OK 0
+#define ENGINE_ERROR 1                    // File could not be read or written
+#define ENGINE_NO_FLIGHT 2                // Unknown flight number
+#define ENGINE_FLIGHT_FULL 3
+#define ENGINE_FLIGHT_EXISTS 4
+#define ENGINE_SEAT_TAKEN 5               // Booked by an active reservation
+#define ENGINE_SEAT_HELD 6                // Held by a booking in progress
+#define ENGINE_HOLD_EXPIRED 7
+#define ENGINE_NOT_FOUND 8                // No active reservation for the PNR
+#define ENGINE_INVALID 9                  // Request field out of range
+#define ENGINE_READ_ONLY 10               // Follower engines cannot write
+#define ENGINE_ARCHIVED 11                // Reservation or flight is in the read-only archive
+
+typedef struct {
+    char name[MAX_NAME_LEN + 1];      // +1 for null terminator
+    int age;
+    char gender;                      // 'M' or 'F'
+    int seatNumber;                   // 1 to MAX_SEATS
+    char pnr[PNR_LEN + 1];           // +1 for null terminator
+    int flightNumber;
+    float fare;
+    int paymentMethod;                // 1-4
+    int isBooked;                     // 1 for booked, 0 for cancelled
+} Passenger;
+
+typedef struct {
+    int flightNumber;
+    char destination[MAX_DEST_LEN + 1];
+    char departure[MAX_DEST_LEN + 1];
+    char time[MAX_TIME_LEN + 1];
+    float fare;
+    int availableSeats;               // Should be 0 to MAX_SEATS
+    char date[MAX_DATE_LEN + 1];      // Departure date YYYY-MM-DD ("" if unknown)
+    int durationMinutes;              // Time to destination, 0 if unknown
+    float baseFare;                   // Fare set by the admin; fare is the current load price
+    int fareBucket;                   // Current load bucket in the pricing rules
+} Flight;
+
+typedef struct {
+    const char *logDir;               // Change log directory, NULL for CHANGE_LOG_DIR
+    const char *followDir;            // Primary's log directory to replicate, or NULL
+    const char *storage;              // "stdio" or "io_uring", NULL for the default
+    int fsync;                        // Sync every reservation append
+    void (*log)(const char *message); // Warnings and notices (no newline), NULL to drop them
+} EngineOptions;
+
+typedef struct {
+    FILE *flightFile;                 // flights.dat, open for the engine's lifetime
+    Flight *flights;                  // In-memory copy, in file order
+    int flightCount;
+    int flightCap;
+    int *flightSlots;                 // Open addressing by flight number, index + 1 (0 = empty)
+    int flightSlotCount;
+    dev_t flightDevice;               // Identity and mtime of the loaded flights.dat
+    ino_t flightInode;
+    struct timespec flightModified;
+    off_t flightSize;
+    time_t flightChecked;             // When the copy was last read from disk
+    int readOnly;                     // Following a primary
+} ReservationEngine;
+
+typedef struct {
+    char name[MAX_NAME_LEN + 1];
+    int age;                          // 1-120
+    char gender;                      // 'M' or 'F'
+    int flightNumber;
+    int seatNumber;
+    int paymentMethod;                // 1-4
+    float fare;                       // Fare engineHoldSeat quoted for hold; else priced at booking
+    int hold;                         // Handle from engineHoldSeat, or -1
+} BookingRequest;
+
+typedef struct {
+    int flights;
+    long activeBookings;
+    long cancelledBookings;
+    double revenue;                   // Fares of active bookings
+    double averageFare;
+    long long sequence;               // Change log position the totals reflect
+} EngineReport;
+
+typedef struct {
+    const char *storage;              // Backend name
+    int fsync;
+    int filterAvailable;              // PNR filter mapped
+    long long filterEntries;
+    unsigned int filterBits;
+    unsigned int filterHashes;
+    double filterFill;                // Fraction of bits set
+    double filterEstimatedRate;       // False-positive rate implied by the fill
+    long long filterLookups;
+    long long filterDefiniteMisses;
+    long long filterFalsePositives;
+    int archivedFlights;              // Flights moved to the archive tier
+    long long archivedRecords;
+    long long archiveBytes;           // Archive files on disk
+    long long archiveRawBytes;        // The same records as hot segments
+} EngineStats;
+
+typedef struct {
+    const char *followDir;
+    long long appliedSequence;
+    long long primarySequence;
+    long long lagSeconds;
+    long long appliedCommit;          // Primary commit time of the last applied record, 0 if none
+} ReplicaStatus;
+
+typedef struct {
+    Flight legs[ITINERARY_MAX_LEGS];
+    int legCount;
+    float fare;
+    long duration;                    // First departure to last arrival, minutes
+} Itinerary;
+
+typedef struct {
+    int flightNumber;
+    FILE *fp;                         // The segment file as it was at capture
+    long records;                     // Records visible to the snapshot
+} SnapshotSegment;
+
+typedef struct {
+    long long sequence;               // Change log position the snapshot reflects
+    time_t takenAt;
+    Flight *flights;                  // Flights as of the snapshot
+    int flightCount;
+    SnapshotSegment *segments;
+    int segmentCount;
+    SnapshotSegment *archives;        // Archived flights; records are compressed by column
+    int archiveCount;
+} EngineSnapshot;
+
+typedef struct {
+    time_t start;                     // Start of the window
+    long booked;                      // Bookings made in the window
+    long cancelled;                   // Cancellations, including moves to another flight
+    long sold;                        // Net seats sold by the end of the window
+} SeriesPoint;
+
+typedef struct {
+    long booked;
+    long cancelled;
+    double bookedPerDay;
+    double netPerDay;                 // Bookings less cancellations
+} SalesRate;
+
+typedef struct {
+    int flightNumber;                 // 0 = all flights
+    int status;                       // EXPORT_STATUS_*
+    int fromDate;                     // YYMMDD booking date, 0 = open
+    int toDate;                       // YYMMDD booking date, 0 = open
+} ExportFilter;
+
+typedef struct {
+    int flightNumber;                 // 0 = all flights
+    char namePrefix[MAX_NAME_LEN + 1];// Case-insensitive, "" = any name
+    int paymentMethod;                // 1-4, 0 = any
+    int status;                       // EXPORT_STATUS_*
+} ListingFilter;
+
+/* Engine lifetime */
+int engineOpen(ReservationEngine *engine, const EngineOptions *options);
+void engineClose(ReservationEngine *engine);
+const char *engineStatusText(int status);
+
+/* Flights */
+int engineFlights(ReservationEngine *engine, const Flight **flights);
+int engineFindFlight(ReservationEngine *engine, int flightNumber, Flight *out);
+int engineAddFlight(ReservationEngine *engine, Flight *flight);
+int engineDeleteFlight(ReservationEngine *engine, int flightNumber, Flight *removed);
+int engineQuote(ReservationEngine *engine, int flightNumber, float *fare);
+int engineSeatMap(ReservationEngine *engine, int flightNumber, unsigned char taken[MAX_SEATS]);
+int engineSeatAvailable(ReservationEngine *engine, int flightNumber, int seatNumber);
+float engineFlightFare(const Flight *flight);
+long engineParseFlightDate(const char *date);
+long engineDepartureMinutes(const Flight *flight);
+
+/* Reservations */
+int engineHoldSeat(ReservationEngine *engine, int flightNumber, int seatNumber, int *hold, float *fare);
+void engineReleaseHold(int hold);
+int engineBook(ReservationEngine *engine, const BookingRequest *request, Passenger *booked);
+int engineCancel(ReservationEngine *engine, const char *pnr, Passenger *cancelled);
+int engineModify(ReservationEngine *engine, const char *pnr, const Passenger *changes, Passenger *result);
+int engineLookup(ReservationEngine *engine, const char *pnr, Passenger *out);
+long engineScanReservations(ReservationEngine *engine,
+                            int (*visit)(const Passenger *p, void *arg), void *arg);
+int engineListReservations(ReservationEngine *engine, const ListingFilter *filter, const char *cursor,
+                           Passenger *rows, int pageSize, int *count, char *nextCursor);
+
+/* Snapshots: consistent point-in-time reads that never block writers */
+int engineOpenSnapshot(ReservationEngine *engine, EngineSnapshot *snapshot);
+long engineScanSnapshot(const EngineSnapshot *snapshot,
+                        int (*visit)(const Passenger *p, void *arg), void *arg);
+void engineCloseSnapshot(EngineSnapshot *snapshot);
+
+/* Reports and tools */
+int engineReport(ReservationEngine *engine, EngineReport *report);
+void engineStats(ReservationEngine *engine, EngineStats *stats);
+int engineArchiveDeparted(ReservationEngine *engine, int *flights, long *records);
+int engineBookingCurve(ReservationEngine *engine, int flightNumber, int windowHours,
+                       SeriesPoint *points, int maxPoints, int *count);
+int engineRateOfSale(ReservationEngine *engine, int flightNumber, time_t from, time_t to, SalesRate *rate);
+int engineSearchItineraries(ReservationEngine *engine, const char *from, const char *to, long day,
+                            int byDuration, Itinerary *results, int maxResults);
+int engineParseExportDate(const char *text);
+long engineExportReservations(ReservationEngine *engine, const char *path, int format,
+                              const ExportFilter *filter);
+long engineExportFlights(ReservationEngine *engine, const char *path, int format);
+long engineImportReservations(ReservationEngine *engine, const char *path, long *rejected, FILE *report);
+long engineImportSchedule(ReservationEngine *engine, const char *path, long *rejected, FILE *report);
+int engineSelectStorage(const char *name);
+void engineBenchmarkStorage(int records, FILE *out);
+int engineReplayPricing(const char *rulesPath, FILE *out);
+
+/* Read replicas */
+long engineCatchUp(ReservationEngine *engine);
+void engineReplicaStatus(ReservationEngine *engine, ReplicaStatus *status);
+
+#endif
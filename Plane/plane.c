@@ -3,43 +3,27 @@
 #include <string.h>
 #include <time.h>
 #include <ctype.h>
+#include <limits.h>
 
-#define MAX_SEATS 100
-#define MAX_FLIGHTS 10
-#define MAX_NAME_LEN 49
-#define MAX_DEST_LEN 49
-#define MAX_TIME_LEN 9
-#define PNR_LEN 9
-#define ADMIN_PASS_LEN 49
+#include "engine.h"
 
-#define RESERVATION_FILE "reservations.dat"
-#define FLIGHT_FILE "flights.dat"
-#define TEMP_FILE "temp.dat"
+#define ADMIN_PASS_LEN 49
 #define ADMIN_PASSWORD "admin123"
+#define RESERVATIONS_PER_PAGE 20          // Rows shown before asking to continue
+#define TREND_POINTS 30                   // Windows shown in a booking curve
+#define TREND_BAR_WIDTH 40
 
-typedef struct {
-    char name[MAX_NAME_LEN + 1];      // +1 for null terminator
-    int age;
-    char gender;                      // 'M' or 'F'
-    int seatNumber;                   // 1 to MAX_SEATS
-    char pnr[PNR_LEN + 1];           // +1 for null terminator
-    int flightNumber;
-    float fare;
-    int paymentMethod;                // 1-4
-    int isBooked;                     // 1 for booked, 0 for cancelled
-} Passenger;
-
-typedef struct {
-    int flightNumber;
-    char destination[MAX_DEST_LEN + 1];
-    char departure[MAX_DEST_LEN + 1];
-    char time[MAX_TIME_LEN + 1];
-    float fare;
-    int availableSeats;               // Should be 0 to MAX_SEATS
-} Flight;
+static ReservationEngine engine;      // Opened in main, shared by every menu
 
 /* ================ UTILITY FUNCTIONS ================ */
 
+/**
+ * Show the engine's warnings and notices on the terminal
+ */
+static void printEngineMessage(const char *message) {
+    printf("%s\n", message);
+}
+
 /**
  * Clear input buffer to prevent issues with scanf/fgets mixing
  */
@@ -95,243 +79,93 @@ int safeIntInput(const char *prompt, int min, int max) {
 }
 
 /**
- * Initialize data files with proper binary mode
- */
-void initializeFiles() {
-    FILE *fp;
-    
-    // Initialize reservations file
-    fp = fopen(RESERVATION_FILE, "ab");
-    if (fp == NULL) {
-        printf("Warning: Could not create/access reservation file.\n");
-    } else {
-        fclose(fp);
-    }
-    
-    // Initialize flights file
-    fp = fopen(FLIGHT_FILE, "ab");
-    if (fp == NULL) {
-        printf("Warning: Could not create/access flights file.\n");
-    } else {
-        fclose(fp);
-    }
-}
-
-/**
- * Generate a unique PNR based on timestamp and random number
- * This prevents collisions better than sequential counting
- */
-void generatePNR(char *pnr) {
-    time_t now = time(NULL);
-    struct tm *tm = localtime(&now);
-    int randomNum = rand() % 10000;
-    
-    // Format: YYMMDD + random 4 digits
-    snprintf(pnr, PNR_LEN + 1, "%02d%02d%02d%04d",
-             tm->tm_year % 100, tm->tm_mon + 1, tm->tm_mday, randomNum);
-}
-
-/* ================ FLIGHT MANAGEMENT ================ */
-
-/**
- * Check if a flight exists and has available seats
+ * Print a payment method name
  */
-int isFlightValid(int flightNumber) {
-    Flight flight;
-    FILE *fp = fopen(FLIGHT_FILE, "rb");
-    
-    if (!fp) {
-        return 0;
-    }
-    
-    int isValid = 0;
-    while (fread(&flight, sizeof(Flight), 1, fp) == 1) {
-        if (flight.flightNumber == flightNumber && flight.availableSeats > 0) {
-            isValid = 1;
-            break;
-        }
+void printPaymentMethod(int paymentMethod) {
+    switch (paymentMethod) {
+        case 1: printf("Credit Card"); break;
+        case 2: printf("Debit Card"); break;
+        case 3: printf("Net Banking"); break;
+        case 4: printf("UPI"); break;
     }
-    
-    fclose(fp);
-    return isValid;
 }
 
-/**
- * Get fare for a specific flight
- */
-float getFlightFare(int flightNumber) {
-    Flight flight;
-    FILE *fp = fopen(FLIGHT_FILE, "rb");
-    
-    if (!fp) {
-        return -1.0f;
-    }
-    
-    float fare = -1.0f;
-    while (fread(&flight, sizeof(Flight), 1, fp) == 1) {
-        if (flight.flightNumber == flightNumber) {
-            fare = flight.fare;
-            break;
-        }
-    }
-    
-    fclose(fp);
-    return fare;
-}
+/* ================ FLIGHT DISPLAY ================ */
 
 /**
- * Update available seats for a flight
+ * Print the flight table, optionally only flights with free seats
  */
-int updateFlightSeats(int flightNumber, int delta) {
-    Flight flight;
-    FILE *fp = fopen(FLIGHT_FILE, "r+b");
-    
-    if (!fp) {
-        return 0;
-    }
+static void printFlights(int availableOnly) {
+    const Flight *flights;
+    int count = engineFlights(&engine, &flights);
     
-    int updated = 0;
-    while (fread(&flight, sizeof(Flight), 1, fp) == 1) {
-        if (flight.flightNumber == flightNumber) {
-            // Ensure seat count stays within valid range
-            int newSeats = flight.availableSeats + delta;
-            if (newSeats >= 0 && newSeats <= MAX_SEATS) {
-                flight.availableSeats = newSeats;
-                fseek(fp, -sizeof(Flight), SEEK_CUR);
-                fwrite(&flight, sizeof(Flight), 1, fp);
-                updated = 1;
-            }
-            break;
-        }
-    }
-    
-    fclose(fp);
-    return updated;
-}
-
-/**
- * Display all available flights
- */
-void displayAvailableFlights() {
-    Flight flight;
-    FILE *fp = fopen(FLIGHT_FILE, "rb");
-    
-    if (!fp) {
+    if (count < 0) {
         printf("No flights available.\n");
         return;
     }
     
-    printf("\n%-10s %-15s %-15s %-8s %-8s %s\n", 
-           "Flight No.", "Destination", "Departure", "Time", "Fare", "Seats");
-    printf("------------------------------------------------------------------------\n");
+    printf("\n%-10s %-15s %-15s %-10s %-8s %-8s %s\n",
+           "Flight No.", "Destination", "Departure", "Date", "Time", "Fare", "Seats");
+    printf("-----------------------------------------------------------------------------------\n");
     
     int hasFlights = 0;
-    while (fread(&flight, sizeof(Flight), 1, fp) == 1) {
-        if (flight.availableSeats > 0) {
-            printf("%-10d %-15s %-15s %-8s $%-7.2f %d\n",
-                   flight.flightNumber, flight.destination, flight.departure,
-                   flight.time, flight.fare, flight.availableSeats);
+    for (int i = 0; i < count; i++) {
+        const Flight *flight = &flights[i];
+        if (!availableOnly || flight->availableSeats > 0) {
+            printf("%-10d %-15s %-15s %-10s %-8s $%-7.2f %d\n",
+                   flight->flightNumber, flight->destination, flight->departure,
+                   flight->date, flight->time, engineFlightFare(flight), flight->availableSeats);
             hasFlights = 1;
         }
     }
     
-    if (!hasFlights) {
+    if (availableOnly && !hasFlights) {
         printf("No flights with available seats.\n");
     }
     
-    printf("------------------------------------------------------------------------\n");
-    fclose(fp);
+    printf("-----------------------------------------------------------------------------------\n");
 }
 
 /**
- * Display all flights (including full ones)
+ * Display all available flights
  */
-void viewAllFlights() {
-    Flight flight;
-    FILE *fp = fopen(FLIGHT_FILE, "rb");
-    
-    if (!fp) {
-        printf("No flights available.\n");
-        return;
-    }
-    
-    printf("\n%-10s %-15s %-15s %-8s %-8s %s\n", 
-           "Flight No.", "Destination", "Departure", "Time", "Fare", "Seats");
-    printf("------------------------------------------------------------------------\n");
-    
-    while (fread(&flight, sizeof(Flight), 1, fp) == 1) {
-        printf("%-10d %-15s %-15s %-8s $%-7.2f %d\n",
-               flight.flightNumber, flight.destination, flight.departure,
-               flight.time, flight.fare, flight.availableSeats);
-    }
-    
-    printf("------------------------------------------------------------------------\n");
-    fclose(fp);
+void displayAvailableFlights() {
+    printFlights(1);
 }
 
 /**
- * Check if a seat is available on a specific flight
+ * Display all flights (including full ones)
  */
-int isSeatAvailable(int flightNumber, int seatNum) {
-    if (seatNum < 1 || seatNum > MAX_SEATS) {
-        return 0;  // Invalid seat number
-    }
-    
-    Passenger p;
-    FILE *fp = fopen(RESERVATION_FILE, "rb");
-    
-    if (!fp) {
-        return 1;  // No reservations file means all seats are available
-    }
-    
-    int isAvailable = 1;
-    while (fread(&p, sizeof(Passenger), 1, fp) == 1) {
-        if (p.flightNumber == flightNumber && 
-            p.seatNumber == seatNum && 
-            p.isBooked) {
-            isAvailable = 0;
-            break;
-        }
-    }
-    
-    fclose(fp);
-    return isAvailable;
+void viewAllFlights() {
+    printFlights(0);
 }
 
 /**
  * Display available seats for a flight
  */
 void displayAvailableSeats(int flightNumber) {
-    int seats[MAX_SEATS] = {0};  // 0 = available, 1 = booked
-    Passenger p;
-    FILE *fp = fopen(RESERVATION_FILE, "rb");
-    
-    if (fp) {
-        while (fread(&p, sizeof(Passenger), 1, fp) == 1) {
-            if (p.flightNumber == flightNumber && 
-                p.isBooked && 
-                p.seatNumber >= 1 && 
-                p.seatNumber <= MAX_SEATS) {
-                seats[p.seatNumber - 1] = 1;
-            }
-        }
-        fclose(fp);
+    unsigned char taken[MAX_SEATS];
+    int status = engineSeatMap(&engine, flightNumber, taken);
+    if (status == ENGINE_NO_FLIGHT) {
+        printf("Flight %d not found.\n", flightNumber);
+        return;
+    }
+    if (status != ENGINE_OK) {
+        printf("Error: %s.\n", engineStatusText(status));
+        return;
     }
     
     printf("\nAvailable Seats for Flight %d:\n", flightNumber);
     printf("--------------------------------------------------\n");
     
     for (int i = 0; i < MAX_SEATS; i++) {
-        if (seats[i] == 0) {
+        if (!taken[i]) {
             printf("%3d ", i + 1);
-            if ((i + 1) % 10 == 0) {
-                printf("\n");
-            }
         } else {
             printf(" XX ");  // Show booked seats
-            if ((i + 1) % 10 == 0) {
-                printf("\n");
-            }
+        }
+        if ((i + 1) % 10 == 0) {
+            printf("\n");
         }
     }
     printf("\n--------------------------------------------------\n");
@@ -343,55 +177,66 @@ void displayAvailableSeats(int flightNumber) {
  * Book a new ticket
  */
 void bookTicket() {
-    Passenger p;
-    int flightNumber;
+    BookingRequest request;
+    Flight flight;
     
     displayAvailableFlights();
     
     // Get valid flight number
-    flightNumber = safeIntInput("\nEnter Flight Number: ", 1, 999999);
+    memset(&request, 0, sizeof(BookingRequest));
+    request.flightNumber = safeIntInput("\nEnter Flight Number: ", 1, 999999);
     
-    if (!isFlightValid(flightNumber)) {
+    if (engineFindFlight(&engine, request.flightNumber, &flight) != ENGINE_OK ||
+        flight.availableSeats <= 0) {
         printf("Invalid flight number or no seats available.\n");
         return;
     }
     
-    // Initialize passenger structure
-    memset(&p, 0, sizeof(Passenger));
-    p.flightNumber = flightNumber;
-    p.fare = getFlightFare(flightNumber);
-    p.isBooked = 1;
+    float currentFare;
+    engineQuote(&engine, request.flightNumber, &currentFare);
+    printf("Current fare: $%.2f\n", currentFare);
     
     // Get passenger details
     clearInputBuffer();  // Clear any leftover newline
     
-    safeStringInput(p.name, MAX_NAME_LEN, "Enter Passenger Name: ");
+    safeStringInput(request.name, MAX_NAME_LEN, "Enter Passenger Name: ");
     
-    p.age = safeIntInput("Enter Age: ", 1, 120);
+    request.age = safeIntInput("Enter Age: ", 1, 120);
     
     // Get gender with validation
     while (1) {
         printf("Enter Gender (M/F): ");
         char genderInput[10];
         if (fgets(genderInput, sizeof(genderInput), stdin)) {
-            p.gender = toupper(genderInput[0]);
-            if (p.gender == 'M' || p.gender == 'F') {
+            request.gender = toupper(genderInput[0]);
+            if (request.gender == 'M' || request.gender == 'F') {
                 break;
             }
         }
         printf("Invalid gender. Please enter M or F.\n");
     }
     
-    // Get seat number
-    displayAvailableSeats(flightNumber);
+    // Get seat number and hold it while payment details are entered
+    displayAvailableSeats(request.flightNumber);
     while (1) {
-        p.seatNumber = safeIntInput("Choose Seat Number (1-100): ", 1, MAX_SEATS);
+        request.seatNumber = safeIntInput("Choose Seat Number (1-100): ", 1, MAX_SEATS);
         
-        if (isSeatAvailable(flightNumber, p.seatNumber)) {
+        int status = engineHoldSeat(&engine, request.flightNumber, request.seatNumber,
+                                    &request.hold, &request.fare);
+        if (status == ENGINE_OK) {
             break;
         }
-        printf("Seat %d is already booked. Please choose another seat.\n", p.seatNumber);
+        if (status == ENGINE_SEAT_TAKEN) {
+            printf("Seat %d is already booked. Please choose another seat.\n", request.seatNumber);
+        } else if (status == ENGINE_SEAT_HELD) {
+            printf("Seat %d is being booked by someone else. Please choose another seat.\n", request.seatNumber);
+        } else {
+            printf("Error: %s.\n", engineStatusText(status));
+            return;
+        }
     }
+    printf("Seat %d is held for you for %d minutes at $%.2f.\n", request.seatNumber,
+           HOLD_TTL_SECONDS / 60, request.fare);
     
     // Get payment method
     printf("\nSelect Payment Method:\n");
@@ -399,29 +244,19 @@ void bookTicket() {
     printf("2. Debit Card\n");
     printf("3. Net Banking\n");
     printf("4. UPI\n");
-    p.paymentMethod = safeIntInput("Enter choice (1-4): ", 1, 4);
-    
-    // Generate unique PNR
-    generatePNR(p.pnr);
+    request.paymentMethod = safeIntInput("Enter choice (1-4): ", 1, 4);
     
-    // Save reservation
-    FILE *fp = fopen(RESERVATION_FILE, "ab");
-    if (!fp) {
-        printf("Error: Could not save reservation.\n");
+    Passenger p;
+    int status = engineBook(&engine, &request, &p);
+    if (status == ENGINE_HOLD_EXPIRED) {
+        // The hold may have lapsed while payment details were entered
+        printf("Your hold on seat %d has expired. Please start the booking again.\n", request.seatNumber);
         return;
     }
-    
-    if (fwrite(&p, sizeof(Passenger), 1, fp) != 1) {
-        printf("Error: Failed to write reservation data.\n");
-        fclose(fp);
+    if (status != ENGINE_OK) {
+        printf("Error: Failed to book: %s.\n", engineStatusText(status));
         return;
     }
-    fclose(fp);
-    
-    // Update available seats
-    if (!updateFlightSeats(flightNumber, -1)) {
-        printf("Warning: Could not update flight seat count.\n");
-    }
     
     // Display confirmation
     printf("\n=== BOOKING CONFIRMED ===\n");
@@ -431,53 +266,65 @@ void bookTicket() {
     printf("Seat: %d\n", p.seatNumber);
     printf("Fare: $%.2f\n", p.fare);
     printf("Payment Method: ");
-    switch (p.paymentMethod) {
-        case 1: printf("Credit Card\n"); break;
-        case 2: printf("Debit Card\n"); break;
-        case 3: printf("Net Banking\n"); break;
-        case 4: printf("UPI\n"); break;
-    }
-    printf("==========================\n");
+    printPaymentMethod(p.paymentMethod);
+    printf("\n==========================\n");
 }
 
 /**
- * View all active reservations
+ * View reservations a page at a time, filtered by flight, name, payment and status
  */
 void viewReservations() {
-    Passenger p;
-    FILE *fp = fopen(RESERVATION_FILE, "rb");
+    ListingFilter filter;
+    Passenger rows[RESERVATIONS_PER_PAGE];
+    char cursor[LISTING_CURSOR_LEN + 1] = "";
+    char next[LISTING_CURSOR_LEN + 1];
+    char input[10];
+    int count, shown = 0;
+    
+    memset(&filter, 0, sizeof(ListingFilter));
+    filter.flightNumber = safeIntInput("Flight number (0 for all): ", 0, 999999);
+    safeStringInput(filter.namePrefix, MAX_NAME_LEN, "Name starts with (blank for any): ");
+    printf("0. Any\n1. Credit Card\n2. Debit Card\n3. Net Banking\n4. UPI\n");
+    filter.paymentMethod = safeIntInput("Payment method (0-4): ", 0, 4);
+    printf("1. Active\n2. Cancelled\n3. All\n");
+    filter.status = safeIntInput("Status (1-3): ", 1, 3);
+    
+    printf("\n=== RESERVATIONS ===\n");
+    printf("PNR        | Name                | Flight | Seat | Fare     | Status    | Payment\n");
+    printf("-------------------------------------------------------------------------------------\n");
     
-    if (!fp) {
-        printf("No reservations found.\n");
-        return;
-    }
-    
-    printf("\n=== ACTIVE RESERVATIONS ===\n");
-    printf("PNR       | Name                | Flight | Seat | Fare     | Payment\n");
-    printf("------------------------------------------------------------------------\n");
-    
-    int found = 0;
-    while (fread(&p, sizeof(Passenger), 1, fp) == 1) {
-        if (p.isBooked) {
-            found = 1;
-            printf("%-9s | %-19s | %-6d | %-4d | $%-7.2f | ",
-                   p.pnr, p.name, p.flightNumber, p.seatNumber, p.fare);
-            
-            switch (p.paymentMethod) {
-                case 1: printf("Credit Card\n"); break;
-                case 2: printf("Debit Card\n"); break;
-                case 3: printf("Net Banking\n"); break;
-                case 4: printf("UPI\n"); break;
-            }
+    while (1) {
+        int status = engineListReservations(&engine, &filter, cursor, rows, RESERVATIONS_PER_PAGE,
+                                            &count, next);
+        if (status != ENGINE_OK) {
+            printf("Error: %s.\n", engineStatusText(status));
+            break;
+        }
+        
+        for (int i = 0; i < count; i++) {
+            printf("%-10s | %-19s | %-6d | %-4d | $%-7.2f | %-9s | ",
+                   rows[i].pnr, rows[i].name, rows[i].flightNumber, rows[i].seatNumber,
+                   rows[i].fare, rows[i].isBooked ? "Active" : "Cancelled");
+            printPaymentMethod(rows[i].paymentMethod);
+            printf("\n");
+        }
+        shown += count;
+        
+        if (next[0] == '\0') {
+            break;
         }
+        printf("-- %d shown. Press Enter for the next page, q to stop: ", shown);
+        if (!fgets(input, sizeof(input), stdin) || tolower((unsigned char)input[0]) == 'q') {
+            break;
+        }
+        strcpy(cursor, next);
     }
     
-    if (!found) {
-        printf("No active reservations found.\n");
+    if (shown == 0) {
+        printf("No matching reservations found.\n");
     }
     
-    printf("------------------------------------------------------------------------\n");
-    fclose(fp);
+    printf("-------------------------------------------------------------------------------------\n");
 }
 
 /**
@@ -486,61 +333,21 @@ void viewReservations() {
 void cancelReservation() {
     char targetPNR[PNR_LEN + 1];
     printf("Enter PNR to cancel: ");
-    scanf("%s", targetPNR);
+    scanf("%10s", targetPNR);
     clearInputBuffer();
     
-    FILE *fp = fopen(RESERVATION_FILE, "rb");
-    if (!fp) {
-        printf("No reservations found.\n");
-        return;
-    }
-    
-    FILE *temp = fopen(TEMP_FILE, "wb");
-    if (!temp) {
-        printf("Error creating temporary file.\n");
-        fclose(fp);
-        return;
-    }
-    
     Passenger p;
-    int found = 0;
-    int cancelledFlight = -1;
-    
-    while (fread(&p, sizeof(Passenger), 1, fp) == 1) {
-        if (strcmp(p.pnr, targetPNR) == 0 && p.isBooked) {
-            found = 1;
-            cancelledFlight = p.flightNumber;
-            
-            printf("\nCancelling reservation for %s\n", p.name);
-            printf("Flight: %d, Seat: %d\n", p.flightNumber, p.seatNumber);
-            printf("Refund amount: $%.2f\n", p.fare);
-            
-            // Mark as cancelled
-            p.isBooked = 0;
-        }
-        
-        // Write to temp file (including cancelled records)
-        fwrite(&p, sizeof(Passenger), 1, temp);
+    int status = engineCancel(&engine, targetPNR, &p);
+    if (status != ENGINE_OK) {
+        printf("%s.\n", status == ENGINE_NOT_FOUND ? "PNR not found or booking already cancelled"
+                                                   : engineStatusText(status));
+        return;
     }
     
-    fclose(fp);
-    fclose(temp);
-    
-    if (found) {
-        // Replace original file with temp file
-        remove(RESERVATION_FILE);
-        rename(TEMP_FILE, RESERVATION_FILE);
-        
-        // Update available seats
-        if (cancelledFlight != -1) {
-            updateFlightSeats(cancelledFlight, 1);
-        }
-        
-        printf("Reservation cancelled successfully.\n");
-    } else {
-        remove(TEMP_FILE);
-        printf("PNR not found or booking already cancelled.\n");
-    }
+    printf("\nCancelling reservation for %s\n", p.name);
+    printf("Flight: %d, Seat: %d\n", p.flightNumber, p.seatNumber);
+    printf("Refund amount: $%.2f\n", p.fare);
+    printf("Reservation cancelled successfully.\n");
 }
 
 /**
@@ -549,151 +356,112 @@ void cancelReservation() {
 void modifyReservation() {
     char targetPNR[PNR_LEN + 1];
     printf("Enter PNR to modify: ");
-    scanf("%s", targetPNR);
+    scanf("%10s", targetPNR);
     clearInputBuffer();
     
-    FILE *fp = fopen(RESERVATION_FILE, "rb");
-    if (!fp) {
-        printf("No reservations found.\n");
+    Passenger current;
+    int found = engineLookup(&engine, targetPNR, &current);
+    if (found != ENGINE_OK) {
+        printf(found == ENGINE_NOT_FOUND ? "PNR not found or booking cancelled.\n"
+                                         : "Error: Could not read reservations.\n");
         return;
     }
     
-    FILE *temp = fopen(TEMP_FILE, "wb");
-    if (!temp) {
-        printf("Error creating temporary file.\n");
-        fclose(fp);
-        return;
+    Passenger p = current;
+    
+    // Display current details
+    printf("\nCurrent Details:\n");
+    printf("Name: %s\n", p.name);
+    printf("Age: %d\n", p.age);
+    printf("Gender: %c\n", p.gender);
+    printf("Flight: %d\n", p.flightNumber);
+    printf("Seat: %d\n", p.seatNumber);
+    printf("Fare: $%.2f\n", p.fare);
+    printf("Payment: ");
+    printPaymentMethod(p.paymentMethod);
+    printf("\n");
+    
+    printf("\nEnter new details (press Enter to keep current value):\n");
+    
+    // Modify name
+    char input[MAX_NAME_LEN + 10];
+    printf("Name [%s]: ", p.name);
+    if (fgets(input, sizeof(input), stdin) && input[0] != '\n') {
+        input[strcspn(input, "\n")] = '\0';
+        strncpy(p.name, input, MAX_NAME_LEN);
+        p.name[MAX_NAME_LEN] = '\0';
     }
     
-    Passenger p;
-    int found = 0;
-    int oldFlight = -1, oldSeat = -1;
-    
-    while (fread(&p, sizeof(Passenger), 1, fp) == 1) {
-        if (strcmp(p.pnr, targetPNR) == 0 && p.isBooked) {
-            found = 1;
-            oldFlight = p.flightNumber;
-            oldSeat = p.seatNumber;
-            
-            // Display current details
-            printf("\nCurrent Details:\n");
-            printf("Name: %s\n", p.name);
-            printf("Age: %d\n", p.age);
-            printf("Gender: %c\n", p.gender);
-            printf("Flight: %d\n", p.flightNumber);
-            printf("Seat: %d\n", p.seatNumber);
-            printf("Fare: $%.2f\n", p.fare);
-            printf("Payment: ");
-            switch (p.paymentMethod) {
-                case 1: printf("Credit Card\n"); break;
-                case 2: printf("Debit Card\n"); break;
-                case 3: printf("Net Banking\n"); break;
-                case 4: printf("UPI\n"); break;
-            }
-            
-            printf("\nEnter new details (press Enter to keep current value):\n");
-            
-            // Modify name
-            char input[MAX_NAME_LEN + 10];
-            printf("Name [%s]: ", p.name);
-            if (fgets(input, sizeof(input), stdin) && input[0] != '\n') {
-                input[strcspn(input, "\n")] = '\0';
-                strncpy(p.name, input, MAX_NAME_LEN);
-                p.name[MAX_NAME_LEN] = '\0';
-            }
-            
-            // Modify age
-            printf("Age [%d]: ", p.age);
-            if (fgets(input, sizeof(input), stdin) && input[0] != '\n') {
-                p.age = atoi(input);
-                if (p.age < 1 || p.age > 120) {
-                    printf("Invalid age, keeping current value.\n");
-                    p.age = oldSeat; // Restore from temp
-                }
-            }
-            
-            // Modify gender
-            printf("Gender [%c]: ", p.gender);
-            if (fgets(input, sizeof(input), stdin) && input[0] != '\n') {
-                p.gender = toupper(input[0]);
-                if (p.gender != 'M' && p.gender != 'F') {
-                    printf("Invalid gender, keeping current value.\n");
-                    // gender already correct
-                }
-            }
-            
-            // Modify flight
-            displayAvailableFlights();
-            printf("Flight Number [%d]: ", p.flightNumber);
-            if (fgets(input, sizeof(input), stdin) && input[0] != '\n') {
-                int newFlight = atoi(input);
-                if (isFlightValid(newFlight)) {
-                    // Update flight and fare
-                    oldFlight = p.flightNumber;
-                    p.flightNumber = newFlight;
-                    p.fare = getFlightFare(newFlight);
-                } else {
-                    printf("Invalid flight, keeping current flight.\n");
-                }
-            }
-            
-            // Modify seat
-            displayAvailableSeats(p.flightNumber);
-            printf("Seat Number [%d]: ", p.seatNumber);
-            if (fgets(input, sizeof(input), stdin) && input[0] != '\n') {
-                int newSeat = atoi(input);
-                if (isSeatAvailable(p.flightNumber, newSeat)) {
-                    oldSeat = p.seatNumber;
-                    p.seatNumber = newSeat;
-                } else {
-                    printf("Seat not available, keeping current seat.\n");
-                }
-            }
-            
-            // Modify payment
-            printf("Payment Method [");
-            switch (p.paymentMethod) {
-                case 1: printf("Credit Card"); break;
-                case 2: printf("Debit Card"); break;
-                case 3: printf("Net Banking"); break;
-                case 4: printf("UPI"); break;
-            }
-            printf("]\n");
-            printf("1. Credit Card\n2. Debit Card\n3. Net Banking\n4. UPI\n");
-            printf("Enter new choice (1-4): ");
-            if (fgets(input, sizeof(input), stdin) && input[0] != '\n') {
-                int newPayment = atoi(input);
-                if (newPayment >= 1 && newPayment <= 4) {
-                    p.paymentMethod = newPayment;
-                }
-            }
+    // Modify age
+    printf("Age [%d]: ", p.age);
+    if (fgets(input, sizeof(input), stdin) && input[0] != '\n') {
+        p.age = atoi(input);
+        if (p.age < 1 || p.age > 120) {
+            printf("Invalid age, keeping current value.\n");
+            p.age = current.age;
         }
-        
-        fwrite(&p, sizeof(Passenger), 1, temp);
     }
     
-    fclose(fp);
-    fclose(temp);
+    // Modify gender
+    printf("Gender [%c]: ", p.gender);
+    if (fgets(input, sizeof(input), stdin) && input[0] != '\n') {
+        p.gender = toupper(input[0]);
+        if (p.gender != 'M' && p.gender != 'F') {
+            printf("Invalid gender, keeping current value.\n");
+            p.gender = current.gender;
+        }
+    }
     
-    if (found) {
-        // Update flight seat counts if flight or seat changed
-        if (oldFlight != p.flightNumber) {
-            updateFlightSeats(oldFlight, 1);   // Free old seat
-            updateFlightSeats(p.flightNumber, -1); // Reserve new seat
-        } else if (oldSeat != p.seatNumber) {
-            // Same flight, different seat - seat availability already checked
-            // No need to update seat count
+    // Modify flight
+    displayAvailableFlights();
+    printf("Flight Number [%d]: ", p.flightNumber);
+    if (fgets(input, sizeof(input), stdin) && input[0] != '\n') {
+        int newFlight = atoi(input);
+        Flight flight;
+        if (engineFindFlight(&engine, newFlight, &flight) == ENGINE_OK && flight.availableSeats > 0) {
+            p.flightNumber = newFlight;  // Repriced at that flight's fare when saved
+        } else {
+            printf("Invalid flight, keeping current flight.\n");
         }
-        
-        // Replace original file
-        remove(RESERVATION_FILE);
-        rename(TEMP_FILE, RESERVATION_FILE);
-        
-        printf("Reservation modified successfully.\n");
-    } else {
-        remove(TEMP_FILE);
-        printf("PNR not found or booking cancelled.\n");
     }
+    
+    // Modify seat
+    displayAvailableSeats(p.flightNumber);
+    printf("Seat Number [%d]: ", p.seatNumber);
+    if (fgets(input, sizeof(input), stdin) && input[0] != '\n') {
+        int newSeat = atoi(input);
+        if (engineSeatAvailable(&engine, p.flightNumber, newSeat)) {
+            p.seatNumber = newSeat;
+        } else {
+            printf("Seat not available, keeping current seat.\n");
+        }
+    }
+    
+    // Modify payment
+    printf("Payment Method [");
+    printPaymentMethod(p.paymentMethod);
+    printf("]\n");
+    printf("1. Credit Card\n2. Debit Card\n3. Net Banking\n4. UPI\n");
+    printf("Enter new choice (1-4): ");
+    if (fgets(input, sizeof(input), stdin) && input[0] != '\n') {
+        int newPayment = atoi(input);
+        if (newPayment >= 1 && newPayment <= 4) {
+            p.paymentMethod = newPayment;
+        }
+    }
+    
+    // Save the modified record
+    Passenger saved;
+    int status = engineModify(&engine, targetPNR, &p, &saved);
+    if (status != ENGINE_OK) {
+        printf("Error: Could not modify reservation: %s.\n", engineStatusText(status));
+        return;
+    }
+    if (saved.fare != current.fare) {
+        printf("New fare: $%.2f\n", saved.fare);
+    }
+    
+    printf("Reservation modified successfully.\n");
 }
 
 /**
@@ -702,46 +470,252 @@ void modifyReservation() {
 void generateBill() {
     char targetPNR[PNR_LEN + 1];
     printf("Enter PNR to generate bill: ");
-    scanf("%s", targetPNR);
+    scanf("%10s", targetPNR);
     clearInputBuffer();
     
     Passenger p;
-    FILE *fp = fopen(RESERVATION_FILE, "rb");
+    int found = engineLookup(&engine, targetPNR, &p);
+    if (found != ENGINE_OK) {
+        printf(found == ENGINE_NOT_FOUND ? "PNR not found or booking cancelled.\n"
+                                         : "Error: Could not read reservations.\n");
+        return;
+    }
+    
+    printf("\n=== AIRLINE TICKET ===\n");
+    printf("PNR: %s\n", p.pnr);
+    printf("Passenger: %s\n", p.name);
+    printf("Age: %d | Gender: %c\n", p.age, p.gender);
+    printf("Flight: %d\n", p.flightNumber);
+    printf("Seat: %d\n", p.seatNumber);
+    printf("Fare: $%.2f\n", p.fare);
+    printf("Payment Method: ");
+    printPaymentMethod(p.paymentMethod);
+    printf("\nStatus: CONFIRMED\n");
+    printf("========================\n");
+}
+
+/* ================ DATA EXPORT AND IMPORT ================ */
+
+/**
+ * Ask for an export format (CSV or NDJSON)
+ */
+static int promptExportFormat() {
+    printf("1. CSV\n2. NDJSON\n");
+    return safeIntInput("Select format (1-2): ", 1, 2) == 1 ? EXPORT_FORMAT_CSV : EXPORT_FORMAT_NDJSON;
+}
+
+/**
+ * Ask for an export date until it is blank or valid
+ */
+static int promptExportDate(const char *prompt) {
+    char dateInput[16];
+    while (1) {
+        safeStringInput(dateInput, 10, prompt);
+        int date = engineParseExportDate(dateInput);
+        if (date >= 0) {
+            return date;
+        }
+        printf("Invalid date. Please use YYYY-MM-DD.\n");
+    }
+}
+
+/**
+ * Export reservations or flights to a file
+ */
+void exportData() {
+    char path[EXPORT_PATH_LEN + 1];
+    long rows;
+    
+    printf("\n1. Reservations\n2. Flights\n");
+    int what = safeIntInput("Export (1-2): ", 1, 2);
+    int format = promptExportFormat();
+    
+    if (what == 1) {
+        ExportFilter filter;
+        filter.flightNumber = safeIntInput("Flight number (0 for all): ", 0, 999999);
+        printf("1. Active\n2. Cancelled\n3. All\n");
+        filter.status = safeIntInput("Status (1-3): ", 1, 3);
+        filter.fromDate = promptExportDate("Booked from (YYYY-MM-DD, blank for any): ");
+        filter.toDate = promptExportDate("Booked until (YYYY-MM-DD, blank for any): ");
+        safeStringInput(path, EXPORT_PATH_LEN, "Output file: ");
+        
+        rows = engineExportReservations(&engine, path, format, &filter);
+    } else {
+        safeStringInput(path, EXPORT_PATH_LEN, "Output file: ");
+        rows = engineExportFlights(&engine, path, format);
+    }
+    
+    if (rows < 0) {
+        printf("Error: Could not read the data files or write %s.\n", path);
+    } else {
+        printf("Exported %ld records to %s.\n", rows, path);
+    }
+}
+
+/**
+ * Bulk-import reservations or a flight schedule from a CSV or NDJSON file
+ */
+void importData() {
+    char path[EXPORT_PATH_LEN + 1];
+    long rejected, imported;
+    
+    printf("\n1. Reservations\n2. Flight schedule\n");
+    int what = safeIntInput("Import (1-2): ", 1, 2);
+    safeStringInput(path, EXPORT_PATH_LEN, "Input file (CSV or NDJSON): ");
     
-    if (!fp) {
-        printf("No reservations found.\n");
+    if (what == 1) {
+        imported = engineImportReservations(&engine, path, &rejected, stdout);
+    } else {
+        imported = engineImportSchedule(&engine, path, &rejected, stdout);
+    }
+    
+    if (imported < 0) {
+        printf("Error: Could not import %s.\n", path);
         return;
     }
+    printf("Imported %ld %s, rejected %ld rows.\n", imported,
+           what == 1 ? "reservations" : "flights", rejected);
+    if (rejected > IMPORT_REPORT_LIMIT) {
+        printf("(Only the first %d rejected rows are listed.)\n", IMPORT_REPORT_LIMIT);
+    }
+}
+
+/* ================ CONNECTING ITINERARIES ================ */
+
+/**
+ * Ask for a trip and list the best connections
+ */
+void searchConnections() {
+    char from[MAX_DEST_LEN + 1], to[MAX_DEST_LEN + 1], date[MAX_DATE_LEN + 1];
+    long day;
     
-    int found = 0;
-    while (fread(&p, sizeof(Passenger), 1, fp) == 1) {
-        if (strcmp(p.pnr, targetPNR) == 0 && p.isBooked) {
-            found = 1;
-            
-            printf("\n=== AIRLINE TICKET ===\n");
-            printf("PNR: %s\n", p.pnr);
-            printf("Passenger: %s\n", p.name);
-            printf("Age: %d | Gender: %c\n", p.age, p.gender);
-            printf("Flight: %d\n", p.flightNumber);
-            printf("Seat: %d\n", p.seatNumber);
-            printf("Fare: $%.2f\n", p.fare);
-            printf("Payment Method: ");
-            switch (p.paymentMethod) {
-                case 1: printf("Credit Card\n"); break;
-                case 2: printf("Debit Card\n"); break;
-                case 3: printf("Net Banking\n"); break;
-                case 4: printf("UPI\n"); break;
-            }
-            printf("Status: CONFIRMED\n");
-            printf("========================\n");
+    safeStringInput(from, MAX_DEST_LEN, "From (city): ");
+    safeStringInput(to, MAX_DEST_LEN, "To (city): ");
+    while (1) {
+        safeStringInput(date, MAX_DATE_LEN, "Travel Date (YYYY-MM-DD): ");
+        if ((day = engineParseFlightDate(date)) >= 0) {
             break;
         }
+        printf("Invalid date. Please use YYYY-MM-DD.\n");
     }
+    printf("1. Cheapest\n2. Fastest\n");
+    int byDuration = safeIntInput("Sort by (1-2): ", 1, 2) == 2;
     
-    fclose(fp);
+    Itinerary results[ITINERARY_RESULTS];
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int count = engineSearchItineraries(&engine, from, to, day, byDuration, results, ITINERARY_RESULTS);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
     
-    if (!found) {
-        printf("PNR not found or booking cancelled.\n");
+    if (count == 0) {
+        printf("No itineraries with available seats from %s to %s on %s.\n", from, to, date);
+        return;
+    }
+    
+    printf("\n=== ITINERARIES: %s -> %s on %s ===\n", from, to, date);
+    for (int i = 0; i < count; i++) {
+        const Itinerary *it = &results[i];
+        printf("\nOption %d: $%.2f, %ldh %02ldm, ", i + 1, it->fare,
+               it->duration / 60, it->duration % 60);
+        if (it->legCount == 1) {
+            printf("direct\n");
+        } else {
+            printf("%d stop%s\n", it->legCount - 1, it->legCount > 2 ? "s" : "");
+        }
+        
+        for (int l = 0; l < it->legCount; l++) {
+            const Flight *leg = &it->legs[l];
+            if (l > 0) {
+                const Flight *previous = &it->legs[l - 1];
+                long layover = engineDepartureMinutes(leg) -
+                               (engineDepartureMinutes(previous) + previous->durationMinutes);
+                printf("    Layover in %s: %ldh %02ldm\n", leg->departure,
+                       layover / 60, layover % 60);
+            }
+            printf("  Flight %-6d %s -> %s  %s %s  (%dh %02dm, $%.2f, %d seats)\n",
+                   leg->flightNumber, leg->departure, leg->destination,
+                   leg->date, leg->time, leg->durationMinutes / 60,
+                   leg->durationMinutes % 60, engineFlightFare(leg), leg->availableSeats);
+        }
+    }
+    
+    const Flight *flights;
+    printf("\nSearched %d flights in %.2f ms.\n", engineFlights(&engine, &flights),
+           (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+}
+
+/* ================ READ REPLICA ================ */
+
+/**
+ * Bring the follower up to date, warning if it can no longer follow
+ */
+static void catchUpReplica() {
+    if (engineCatchUp(&engine) < 0) {
+        printf("Warning: The primary's change log was reset (data upgrade).\n");
+        printf("Rebuild this replica by starting it in an empty directory.\n");
+    }
+}
+
+/**
+ * Show how far the follower is behind the primary
+ */
+void showReplicationStatus() {
+    ReplicaStatus status;
+    engineReplicaStatus(&engine, &status);
+    
+    printf("\n=== REPLICATION STATUS ===\n");
+    printf("Following: %s\n", status.followDir);
+    printf("Applied sequence: %lld\n", status.appliedSequence);
+    printf("Primary sequence: %lld\n", status.primarySequence);
+    printf("Records behind: %lld\n", status.primarySequence - status.appliedSequence);
+    printf("Replication lag: %lld s\n", status.lagSeconds);
+    if (status.appliedCommit > 0) {
+        printf("Last change committed: %lld s ago\n",
+               (long long)time(NULL) - status.appliedCommit);
+    }
+    printf("==========================\n");
+}
+
+/**
+ * Read-only menu served by a follower
+ */
+void followerMenu() {
+    catchUpReplica();
+    
+    int choice;
+    while (1) {
+        printf("\n--- READ REPLICA MENU ---\n");
+        printf("1. View All Flights\n");
+        printf("2. View Seat Availability\n");
+        printf("3. View All Reservations\n");
+        printf("4. Generate Bill\n");
+        printf("5. Search Connecting Flights\n");
+        printf("6. Replication Status\n");
+        printf("7. Exit\n");
+        printf("Enter your choice: ");
+        
+        if (scanf("%d", &choice) != 1) {
+            clearInputBuffer();
+            printf("Invalid input. Please enter a number.\n");
+            continue;
+        }
+        clearInputBuffer();
+        
+        // Serve every query from an up-to-date copy
+        if (choice >= 1 && choice <= 5) {
+            catchUpReplica();
+        }
+        
+        switch (choice) {
+            case 1: viewAllFlights(); break;
+            case 2: displayAvailableSeats(safeIntInput("Enter Flight Number: ", 1, 999999)); break;
+            case 3: viewReservations(); break;
+            case 4: generateBill(); break;
+            case 5: searchConnections(); break;
+            case 6: showReplicationStatus(); break;
+            case 7: return;
+            default: printf("Invalid choice!\n");
+        }
     }
 }
 
@@ -752,49 +726,41 @@ void generateBill() {
  */
 void addFlight() {
     Flight flight;
+    memset(&flight, 0, sizeof(Flight));
     
     printf("\nEnter Flight Number: ");
     scanf("%d", &flight.flightNumber);
     clearInputBuffer();
     
     // Check if flight already exists
-    FILE *fp = fopen(FLIGHT_FILE, "rb");
-    if (fp) {
-        Flight temp;
-        while (fread(&temp, sizeof(Flight), 1, fp) == 1) {
-            if (temp.flightNumber == flight.flightNumber) {
-                printf("Flight number already exists!\n");
-                fclose(fp);
-                return;
-            }
-        }
-        fclose(fp);
+    if (engineFindFlight(&engine, flight.flightNumber, NULL) == ENGINE_OK) {
+        printf("Flight number already exists!\n");
+        return;
     }
     
     safeStringInput(flight.destination, MAX_DEST_LEN, "Enter Destination: ");
     safeStringInput(flight.departure, MAX_DEST_LEN, "Enter Departure City: ");
     safeStringInput(flight.time, MAX_TIME_LEN, "Enter Departure Time (HH:MM): ");
     
-    printf("Enter Fare: ");
-    scanf("%f", &flight.fare);
-    clearInputBuffer();
+    while (1) {
+        safeStringInput(flight.date, MAX_DATE_LEN, "Enter Departure Date (YYYY-MM-DD): ");
+        if (engineParseFlightDate(flight.date) >= 0) {
+            break;
+        }
+        printf("Invalid date. Please use YYYY-MM-DD.\n");
+    }
+    flight.durationMinutes = safeIntInput("Enter Flight Duration (minutes): ", 1, 48 * 60);
     
-    flight.availableSeats = MAX_SEATS;
+    printf("Enter Base Fare: ");
+    scanf("%f", &flight.baseFare);
+    clearInputBuffer();
     
-    // Save flight
-    fp = fopen(FLIGHT_FILE, "ab");
-    if (!fp) {
-        printf("Error saving flight.\n");
+    int status = engineAddFlight(&engine, &flight);
+    if (status != ENGINE_OK) {
+        printf("Error saving flight: %s.\n", engineStatusText(status));
         return;
     }
-    
-    if (fwrite(&flight, sizeof(Flight), 1, fp) != 1) {
-        printf("Error writing flight data.\n");
-    } else {
-        printf("Flight added successfully!\n");
-    }
-    
-    fclose(fp);
+    printf("Flight added successfully!\n");
 }
 
 /**
@@ -803,40 +769,11 @@ void addFlight() {
 void deleteFlight() {
     int flightNumber = safeIntInput("Enter Flight Number to delete: ", 1, 999999);
     
-    FILE *fp = fopen(FLIGHT_FILE, "rb");
-    if (!fp) {
-        printf("No flights available.\n");
-        return;
-    }
-    
-    FILE *temp = fopen(TEMP_FILE, "wb");
-    if (!temp) {
-        printf("Error creating temporary file.\n");
-        fclose(fp);
-        return;
-    }
-    
     Flight flight;
-    int found = 0;
-    
-    while (fread(&flight, sizeof(Flight), 1, fp) == 1) {
-        if (flight.flightNumber == flightNumber) {
-            found = 1;
-            printf("Deleting Flight %d to %s\n", flight.flightNumber, flight.destination);
-        } else {
-            fwrite(&flight, sizeof(Flight), 1, temp);
-        }
-    }
-    
-    fclose(fp);
-    fclose(temp);
-    
-    if (found) {
-        remove(FLIGHT_FILE);
-        rename(TEMP_FILE, FLIGHT_FILE);
+    if (engineDeleteFlight(&engine, flightNumber, &flight) == ENGINE_OK) {
+        printf("Deleting Flight %d to %s\n", flight.flightNumber, flight.destination);
         printf("Flight deleted successfully.\n");
     } else {
-        remove(TEMP_FILE);
         printf("Flight not found.\n");
     }
 }
@@ -845,35 +782,140 @@ void deleteFlight() {
  * Generate financial report
  */
 void generateFinancialReport() {
-    Passenger p;
-    FILE *fp = fopen(RESERVATION_FILE, "rb");
-    
-    if (!fp) {
-        printf("No reservations found.\n");
+    EngineReport report;
+    int status = engineReport(&engine, &report);
+    if (status != ENGINE_OK) {
+        printf("Error: %s.\n", engineStatusText(status));
         return;
     }
     
-    float totalRevenue = 0.0f;
-    int bookings = 0;
+    printf("\n=== FINANCIAL REPORT ===\n");
+    printf("Total Bookings: %ld\n", report.activeBookings);
+    printf("Total Revenue: $%.2f\n", report.revenue);
+    printf("Average Fare: $%.2f\n", report.averageFare);
+    printf("As of change: %lld\n", report.sequence);
+    printf("=======================\n");
+}
+
+/**
+ * System statistics
+ */
+void showSystemStats() {
+    EngineStats stats;
+    engineStats(&engine, &stats);
+    
+    printf("\n=== SYSTEM STATISTICS ===\n");
+    printf("Storage backend: %s%s\n", stats.storage, stats.fsync ? " (fsync)" : "");
     
-    while (fread(&p, sizeof(Passenger), 1, fp) == 1) {
-        if (p.isBooked) {
-            totalRevenue += p.fare;
-            bookings++;
+    printf("\n--- PNR Filter ---\n");
+    if (!stats.filterAvailable) {
+        printf("Filter not available; every lookup reads the index.\n");
+    } else {
+        long long misses = stats.filterDefiniteMisses + stats.filterFalsePositives;
+        printf("Entries added: %lld\n", stats.filterEntries);
+        printf("Size: %u bits, %u hashes, %.2f%% set\n", stats.filterBits, stats.filterHashes,
+               stats.filterFill * 100.0);
+        printf("Lookups: %lld\n", stats.filterLookups);
+        printf("Rejected without reading the index: %lld\n", stats.filterDefiniteMisses);
+        printf("False positives: %lld\n", stats.filterFalsePositives);
+        if (misses > 0) {
+            printf("Measured false-positive rate: %.4f%%\n", 100.0 * stats.filterFalsePositives / misses);
+        } else {
+            printf("Measured false-positive rate: n/a (no unknown PNRs looked up yet)\n");
         }
+        printf("Estimated false-positive rate: %.4f%%\n", stats.filterEstimatedRate * 100.0);
     }
     
-    fclose(fp);
-    
-    printf("\n=== FINANCIAL REPORT ===\n");
-    printf("Total Bookings: %d\n", bookings);
-    printf("Total Revenue: $%.2f\n", totalRevenue);
-    if (bookings > 0) {
-        printf("Average Fare: $%.2f\n", totalRevenue / bookings);
+    printf("\n--- Archive ---\n");
+    if (stats.archivedFlights == 0) {
+        printf("No flights archived.\n");
     } else {
-        printf("Average Fare: $0.00\n");
+        printf("Flights: %d, reservations: %lld\n", stats.archivedFlights, stats.archivedRecords);
+        printf("Size: %lld bytes (%lld as hot segments, %.1fx smaller)\n", stats.archiveBytes,
+               stats.archiveRawBytes, stats.archiveBytes > 0 ? (double)stats.archiveRawBytes / stats.archiveBytes : 0.0);
+    }
+    printf("=========================\n");
+}
+
+/**
+ * Booking curve and rate of sale from the per-flight time series
+ */
+void showBookingTrends() {
+    static const int windowHours[] = { 1, 24, 168 };
+    static const char *windowNames[] = { "Hour", "Day", "Week" };
+    SeriesPoint points[TREND_POINTS];
+    int count;
+    
+    int flightNumber = safeIntInput("Flight number (0 for all flights): ", 0, 999999);
+    
+    if (flightNumber != 0) {
+        printf("1. Hourly\n2. Daily\n3. Weekly\n");
+        int window = safeIntInput("Window (1-3): ", 1, 3) - 1;
+        int status = engineBookingCurve(&engine, flightNumber, windowHours[window], points, TREND_POINTS, &count);
+        if (status != ENGINE_OK) {
+            printf("Error: %s.\n", engineStatusText(status));
+            return;
+        }
+        
+        printf("\n=== BOOKING CURVE: FLIGHT %d ===\n", flightNumber);
+        if (count == 0) {
+            printf("No bookings recorded for this flight.\n");
+        } else {
+            long peak = 1;
+            for (int i = 0; i < count; i++) {
+                if (points[i].sold > peak) {
+                    peak = points[i].sold;
+                }
+            }
+            
+            printf("%-16s | %-6s | %-9s | %-4s |\n", windowNames[window], "Booked", "Cancelled", "Sold");
+            printf("--------------------------------------------------------------------------------\n");
+            for (int i = 0; i < count; i++) {
+                char start[20];
+                strftime(start, sizeof(start), window == 0 ? "%Y-%m-%d %H:00" : "%Y-%m-%d",
+                         gmtime(&points[i].start));
+                printf("%-16s | %-6ld | %-9ld | %-4ld | ", start, points[i].booked, points[i].cancelled,
+                       points[i].sold);
+                for (long bar = 0; bar < points[i].sold * TREND_BAR_WIDTH / peak; bar++) {
+                    printf("#");
+                }
+                printf("\n");
+            }
+        }
+    }
+    
+    // Rate of sale over trailing windows
+    static const int trailingDays[] = { 1, 7, 30 };
+    time_t now = time(NULL);
+    printf("\n--- Rate of Sale (%s) ---\n", flightNumber ? "this flight" : "all flights");
+    printf("%-14s | %-6s | %-9s | %-10s | %s\n", "Window", "Booked", "Cancelled", "Booked/day", "Net/day");
+    for (int i = 0; i < 3; i++) {
+        SalesRate rate;
+        char label[20];
+        engineRateOfSale(&engine, flightNumber, now - (time_t)trailingDays[i] * 86400, now + 1, &rate);
+        snprintf(label, sizeof(label), "Last %d day%s", trailingDays[i], trailingDays[i] > 1 ? "s" : "");
+        printf("%-14s | %-6ld | %-9ld | %-10.2f | %.2f\n", label, rate.booked, rate.cancelled,
+               rate.bookedPerDay, rate.netPerDay);
+    }
+    printf("=================================\n");
+}
+
+/**
+ * Move reservations of departed flights to the compressed archive
+ */
+void archiveDepartedFlights() {
+    int flights;
+    long records;
+    int status = engineArchiveDeparted(&engine, &flights, &records);
+    
+    if (status != ENGINE_OK) {
+        printf("Error: %s.\n", engineStatusText(status));
+    }
+    if (flights == 0 && status == ENGINE_OK) {
+        printf("No departed flights with reservations to archive.\n");
+    } else if (flights > 0) {
+        printf("Archived %ld reservations from %d departed flights.\n", records, flights);
     }
-    printf("=======================\n");
 }
 
 /**
@@ -909,7 +951,12 @@ void adminMenu() {
         printf("3. Delete Flight\n");
         printf("4. View All Reservations\n");
         printf("5. View Financial Report\n");
-        printf("6. Back to Main Menu\n");
+        printf("6. Export Data\n");
+        printf("7. Import Data\n");
+        printf("8. System Statistics\n");
+        printf("9. Archive Departed Flights\n");
+        printf("10. Booking Trends\n");
+        printf("11. Back to Main Menu\n");
         printf("Enter your choice: ");
         
         scanf("%d", &choice);
@@ -921,7 +968,12 @@ void adminMenu() {
             case 3: deleteFlight(); break;
             case 4: viewReservations(); break;
             case 5: generateFinancialReport(); break;
-            case 6: return;
+            case 6: exportData(); break;
+            case 7: importData(); break;
+            case 8: showSystemStats(); break;
+            case 9: archiveDepartedFlights(); break;
+            case 10: showBookingTrends(); break;
+            case 11: return;
             default: printf("Invalid choice!\n");
         }
     }
@@ -939,7 +991,8 @@ void userMenu() {
         printf("3. Modify Reservation\n");
         printf("4. Cancel Reservation\n");
         printf("5. Generate Bill\n");
-        printf("6. Back to Main Menu\n");
+        printf("6. Search Connecting Flights\n");
+        printf("7. Back to Main Menu\n");
         printf("Enter your choice: ");
         
         scanf("%d", &choice);
@@ -951,7 +1004,8 @@ void userMenu() {
             case 3: modifyReservation(); break;
             case 4: cancelReservation(); break;
             case 5: generateBill(); break;
-            case 6: return;
+            case 6: searchConnections(); break;
+            case 7: return;
             default: printf("Invalid choice!\n");
         }
     }
@@ -959,9 +1013,67 @@ void userMenu() {
 
 /* ================ MAIN FUNCTION ================ */
 
-int main() {
-    srand(time(NULL));  // Seed random number generator
-    initializeFiles();
+int main(int argc, char *argv[]) {
+    // Startup options: --storage=stdio|io_uring, --fsync, --bench-storage[=N],
+    // --log-dir=DIR, --follow=DIR, --replay-pricing[=RULES]
+    EngineOptions options = { NULL, NULL, NULL, 0, printEngineMessage };
+    const char *replayRules = NULL;
+    int replay = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--log-dir=", 10) == 0) {
+            options.logDir = argv[i] + 10;
+        } else if (strncmp(argv[i], "--follow=", 9) == 0) {
+            options.followDir = argv[i] + 9;
+        } else if (strncmp(argv[i], "--storage=", 10) == 0) {
+            options.storage = argv[i] + 10;
+        } else if (strcmp(argv[i], "--fsync") == 0) {
+            options.fsync = 1;
+        } else if (strncmp(argv[i], "--bench-storage", 15) == 0) {
+            int records = argv[i][15] == '=' ? atoi(argv[i] + 16) : 20000;
+            engineBenchmarkStorage(records > 0 ? records : 20000, stdout);
+            return 0;
+        } else if (strncmp(argv[i], "--replay-pricing", 16) == 0) {
+            replay = 1;
+            replayRules = argv[i][16] == '=' ? argv[i] + 17 : NULL;
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    
+    if (options.followDir) {
+        // Follower: replay the primary's log into this directory, read-only
+        char ownLog[PATH_MAX], primaryLog[PATH_MAX];
+        if (realpath(options.followDir, primaryLog) == NULL) {
+            printf("Error: Change log directory %s not found.\n", options.followDir);
+            return 1;
+        }
+        if (realpath(options.logDir ? options.logDir : CHANGE_LOG_DIR, ownLog) != NULL &&
+            strcmp(ownLog, primaryLog) == 0) {
+            printf("Error: A follower must run in its own data directory.\n");
+            return 1;
+        }
+    }
+    
+    if (engineOpen(&engine, &options) != ENGINE_OK) {
+        printf("Error: Could not open the data files.\n");
+        return 1;
+    }
+    
+    if (replay) {
+        int ok = engineReplayPricing(replayRules, stdout);
+        engineClose(&engine);
+        return ok ? 0 : 1;
+    }
+    
+    if (options.followDir) {
+        printf("========================================\n");
+        printf("    AIRLINE RESERVATION SYSTEM (REPLICA)\n");
+        printf("========================================\n");
+        followerMenu();
+        engineClose(&engine);
+        return 0;
+    }
     
     printf("========================================\n");
     printf("    AIRLINE RESERVATION SYSTEM\n");
@@ -985,12 +1097,13 @@ int main() {
         switch (choice) {
             case 1: userMenu(); break;
             case 2: adminMenu(); break;
-            case 3: 
+            case 3:
                 printf("Thank you for using the Airline Reservation System. Goodbye!\n");
+                engineClose(&engine);
                 exit(0);
             default: printf("Invalid choice! Please enter 1, 2, or 3.\n");
         }
     }
     
     return 0;
-}
\ No newline at end of file
+}
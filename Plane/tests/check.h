@@ -0,0 +1,102 @@
+/*
+ * Helpers for the engine tests. A test program includes engine.c itself,
+ * so it can reach static helpers, then this file. run_tests.sh runs each
+ * program in a new empty directory, which becomes its data directory.
+ *
+ * The engine keeps process-wide state, so a test that needs more than one
+ * engine (a primary and a follower, or competing sessions) runs each one
+ * in a child process.
+ */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <sys/wait.h>
+
+static int checkFailures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+        checkFailures++; \
+    } \
+} while (0)
+
+/**
+ * Open an engine on the working directory, optionally following a primary
+ */
+static void openTestEngine(ReservationEngine *engine, const char *followDir) {
+    EngineOptions options;
+    memset(&options, 0, sizeof(options));
+    options.followDir = followDir;
+    if (engineOpen(engine, &options) != ENGINE_OK) {
+        printf("FAIL: could not open the engine\n");
+        exit(1);
+    }
+}
+
+/**
+ * Add a flight with every seat free
+ */
+static int addTestFlight(ReservationEngine *engine, int flightNumber, const char *from,
+                         const char *to, const char *date, const char *time) {
+    Flight flight;
+    memset(&flight, 0, sizeof(flight));
+    flight.flightNumber = flightNumber;
+    snprintf(flight.departure, sizeof(flight.departure), "%s", from);
+    snprintf(flight.destination, sizeof(flight.destination), "%s", to);
+    snprintf(flight.date, sizeof(flight.date), "%s", date);
+    snprintf(flight.time, sizeof(flight.time), "%s", time);
+    flight.durationMinutes = 90;
+    flight.baseFare = 100.0f;
+    return engineAddFlight(engine, &flight);
+}
+
+/**
+ * Book a seat without a hold
+ */
+static int bookTestSeat(ReservationEngine *engine, int flightNumber, int seatNumber,
+                        const char *name, Passenger *booked) {
+    BookingRequest request;
+    memset(&request, 0, sizeof(request));
+    snprintf(request.name, sizeof(request.name), "%s", name);
+    request.age = 30;
+    request.gender = 'F';
+    request.flightNumber = flightNumber;
+    request.seatNumber = seatNumber;
+    request.paymentMethod = 1;
+    request.hold = -1;
+    return engineBook(engine, &request, booked);
+}
+
+/**
+ * Run a function in a child process and return its exit status
+ */
+static int runChild(int (*body)(void *arg), void *arg) {
+    fflush(stdout);  // Or the child prints the parent's pending output again
+    pid_t pid = fork();
+    if (pid < 0) {
+        return -1;
+    }
+    if (pid == 0) {
+        int status = body(arg);
+        fflush(stdout);
+        _exit(status);
+    }
+    
+    int status;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+        return -1;
+    }
+    return WEXITSTATUS(status);
+}
+
+/**
+ * Print the outcome of a test program and return its exit status
+ */
+static int checkResult(const char *name) {
+    printf("%s: %s\n", name, checkFailures ? "FAILED" : "ok");
+    return checkFailures != 0;
+}
+
+#endif
@@ -0,0 +1,22 @@
+#!/bin/sh
+# Build and run every engine test, each in its own empty data directory
+# Usage, from the Plane directory: sh tests/run_tests.sh
+
+cd "$(dirname "$0")/.." || exit 1
+work=$(mktemp -d) || exit 1
+failed=0
+
+for test in tests/test_*.c; do
+    name=$(basename "$test" .c)
+    if ! gcc -O2 -Wall -Wextra -o "$work/$name" "$test" 2> "$work/$name.log"; then
+        cat "$work/$name.log"
+        echo "$name: build failed"
+        failed=1
+        continue
+    fi
+    mkdir "$work/$name.data"
+    (cd "$work/$name.data" && "$work/$name") || failed=1
+done
+
+rm -rf "$work"
+exit $failed
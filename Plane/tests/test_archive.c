@@ -0,0 +1,152 @@
+/*
+ * The archive codec reproduces every input exactly within its stated
+ * output bound, and rejects damaged input. A departed flight moved to the
+ * archive can still be looked up but no longer booked or cancelled.
+ */
+
+#include "../engine.c"
+#include "check.h"
+
+#define CODEC_MAX 140000
+#define ARCHIVE_FLIGHT 501
+#define FUTURE_FLIGHT 502
+#define ARCHIVE_BOOKINGS 30
+
+static unsigned char raw[CODEC_MAX];
+static unsigned char packed[CODEC_MAX + CODEC_MAX / 128 + 1];
+static unsigned char unpacked[CODEC_MAX];
+static unsigned int randomState = 12345;
+
+/**
+ * Deterministic pseudo-random byte
+ */
+static unsigned char randomByte() {
+    randomState = randomState * 1103515245u + 12345u;
+    return (unsigned char)(randomState >> 16);
+}
+
+/**
+ * Compress and decompress raw[0..n), checking the bound and the result
+ * Returns the compressed length
+ */
+static size_t roundTrip(const char *what, size_t n) {
+    size_t packedLength = archiveCompress(raw, n, packed);
+    int ok = packedLength <= n + n / 128 + 1;
+    memset(unpacked, 0xAA, n);
+    ok = ok && archiveDecompress(packed, packedLength, unpacked, n) && memcmp(raw, unpacked, n) == 0;
+    if (!ok) {
+        printf("FAIL: %s (%zu bytes) did not round-trip\n", what, n);
+        checkFailures++;
+    }
+    return packedLength;
+}
+
+/**
+ * Codec inputs that exercise literal runs, overlapping matches and the
+ * edge of the window
+ */
+static void checkCodec() {
+    roundTrip("empty input", 0);
+    
+    raw[0] = 'x';
+    roundTrip("one byte", 1);
+    
+    memcpy(raw, "abcabc", 6);
+    roundTrip("short repeat", 6);
+    
+    memset(raw, 'a', 5000);
+    CHECK(roundTrip("run of one byte", 5000) < 5000 / 10);
+    
+    for (size_t i = 0; i < 4000; i++) {
+        raw[i] = randomByte();
+    }
+    roundTrip("random bytes", 4000);  // Literal runs longer than 128
+    
+    const char *text = "261018 Passenger Name Pune Goa 100.00 ";
+    size_t textLength = strlen(text), n = 0;
+    while (n + textLength <= 20000) {
+        memcpy(raw + n, text, textLength);
+        n += textLength;
+    }
+    CHECK(roundTrip("repeated text", n) < n / 10);
+    
+    // A random block repeated 65535 bytes later, the farthest a match
+    // reaches, compresses better than a fresh random block there
+    memset(raw, 0, 66535);
+    for (size_t i = 0; i < 1000; i++) {
+        raw[i] = randomByte();
+        raw[65535 + i] = randomByte();
+    }
+    size_t fresh = roundTrip("fresh block at the window edge", 66535);
+    memcpy(raw + 65535, raw, 1000);
+    CHECK(roundTrip("repeat at the window edge", 66535) + 500 < fresh);
+    
+    // One byte further it is out of reach and stays literal
+    memset(raw + 65535, 0, 1);
+    memcpy(raw + 65536, raw, 1000);
+    roundTrip("repeat beyond the window", 66536);
+    
+    // Damaged input is refused rather than read past
+    memset(raw, 'b', 1000);
+    size_t packedLength = archiveCompress(raw, 1000, packed);
+    CHECK(!archiveDecompress(packed, packedLength, unpacked, 999));
+    CHECK(!archiveDecompress(packed, packedLength - 1, unpacked, 1000));
+    unsigned char badOffset[] = { 0x80, 0x10, 0x00 };  // Match before the start of the output
+    CHECK(!archiveDecompress(badOffset, sizeof(badOffset), unpacked, 4));
+}
+
+/**
+ * Archive a flight that has departed and check what it still allows
+ */
+static void checkArchivedFlight() {
+    ReservationEngine engine;
+    Passenger booked[ARCHIVE_BOOKINGS], found;
+    EngineStats stats;
+    int flights;
+    long records;
+    
+    openTestEngine(&engine, NULL);
+    CHECK(addTestFlight(&engine, ARCHIVE_FLIGHT, "Pune", "Goa", "2020-01-15", "07:30") == ENGINE_OK);
+    CHECK(addTestFlight(&engine, FUTURE_FLIGHT, "Goa", "Pune", "2031-01-15", "07:30") == ENGINE_OK);
+    for (int i = 0; i < ARCHIVE_BOOKINGS; i++) {
+        CHECK(bookTestSeat(&engine, ARCHIVE_FLIGHT, i + 1, "Archived Passenger", &booked[i]) == ENGINE_OK);
+    }
+    CHECK(engineCancel(&engine, booked[0].pnr, NULL) == ENGINE_OK);
+    booked[0].isBooked = 0;
+    CHECK(bookTestSeat(&engine, FUTURE_FLIGHT, 1, "Future Passenger", NULL) == ENGINE_OK);
+    
+    CHECK(engineArchiveDeparted(&engine, &flights, &records) == ENGINE_OK);
+    CHECK(flights == 1 && records == ARCHIVE_BOOKINGS);
+    engineStats(&engine, &stats);
+    CHECK(stats.archivedFlights == 1 && stats.archivedRecords == ARCHIVE_BOOKINGS);
+    
+    // Archived bookings read back unchanged and can no longer be cancelled
+    for (int i = 1; i < ARCHIVE_BOOKINGS; i++) {
+        CHECK(engineLookup(&engine, booked[i].pnr, &found) == ENGINE_OK);
+        CHECK(found.flightNumber == ARCHIVE_FLIGHT && found.seatNumber == booked[i].seatNumber &&
+              strcmp(found.name, booked[i].name) == 0 && found.age == booked[i].age &&
+              found.fare == booked[i].fare && found.paymentMethod == booked[i].paymentMethod &&
+              found.isBooked);
+    }
+    CHECK(engineCancel(&engine, booked[1].pnr, NULL) == ENGINE_ARCHIVED);
+    unsigned char taken[MAX_SEATS];
+    CHECK(engineSeatMap(&engine, ARCHIVE_FLIGHT, taken) == ENGINE_OK);
+    CHECK(taken[0] == 0 && taken[1] == 1 && taken[ARCHIVE_BOOKINGS - 1] == 1 && taken[ARCHIVE_BOOKINGS] == 0);
+    
+    // The flight and its bookings are closed; other flights are not
+    CHECK(bookTestSeat(&engine, ARCHIVE_FLIGHT, 50, "Late Passenger", NULL) == ENGINE_ARCHIVED);
+    CHECK(engineSeatAvailable(&engine, ARCHIVE_FLIGHT, 50) == 0);
+    CHECK(bookTestSeat(&engine, FUTURE_FLIGHT, 2, "Future Passenger", NULL) == ENGINE_OK);
+    
+    // Archiving again moves nothing
+    CHECK(engineArchiveDeparted(&engine, &flights, &records) == ENGINE_OK);
+    CHECK(flights == 0 && records == 0);
+    
+    engineClose(&engine);
+}
+
+int main() {
+    checkCodec();
+    checkArchivedFlight();
+    return checkResult("archive");
+}
@@ -0,0 +1,185 @@
+/*
+ * A paged listing resumed from its cursor returns every row that was there
+ * when it started exactly once, in order, even when bookings are made and
+ * cancelled between pages: new rows after the cursor show up, new rows
+ * before it do not.
+ */
+
+#include "../engine.c"
+#include "check.h"
+
+#define PAGE_SIZE 10
+#define MAX_EXPECTED 128
+
+typedef struct {
+    int flightNumber;
+    int seatNumber;
+    char pnr[PNR_LEN + 1];
+    char name[MAX_NAME_LEN + 1];
+    int active;
+    int expected;                     // 1 = must be listed, 0 = must not be
+    int seen;
+} ExpectedRow;
+
+static ExpectedRow expectedRows[MAX_EXPECTED];
+static int expectedCount = 0;
+static int nextSeat[500];
+
+/**
+ * Book the next free seat on a flight and record whether a listing should
+ * return it
+ */
+static void bookExpected(ReservationEngine *engine, int flightNumber, const char *name, int expected) {
+    Passenger booked;
+    int status = bookTestSeat(engine, flightNumber, ++nextSeat[flightNumber], name, &booked);
+    CHECK(status == ENGINE_OK);
+    if (status == ENGINE_OK && expectedCount < MAX_EXPECTED) {
+        ExpectedRow *row = &expectedRows[expectedCount++];
+        row->flightNumber = flightNumber;
+        row->seatNumber = booked.seatNumber;
+        snprintf(row->pnr, sizeof(row->pnr), "%s", booked.pnr);
+        snprintf(row->name, sizeof(row->name), "%s", name);
+        row->active = 1;
+        row->expected = expected;
+        row->seen = 0;
+    }
+}
+
+/**
+ * Record a listed row, failing on one listed twice or not booked by the test
+ */
+static void markSeen(const Passenger *p) {
+    for (int i = 0; i < expectedCount; i++) {
+        if (strcmp(expectedRows[i].pnr, p->pnr) == 0) {
+            CHECK(expectedRows[i].flightNumber == p->flightNumber && expectedRows[i].seatNumber == p->seatNumber);
+            CHECK(expectedRows[i].seen == 0);
+            expectedRows[i].seen++;
+            return;
+        }
+    }
+    printf("FAIL: listed unknown PNR %s\n", p->pnr);
+    checkFailures++;
+}
+
+/**
+ * Fetch one page, check it is in order after the previous row, and mark
+ * its rows seen
+ * Returns the number of rows
+ */
+static int readPage(ReservationEngine *engine, const ListingFilter *filter, int order,
+                    char *cursor, Passenger *last) {
+    Passenger rows[PAGE_SIZE];
+    char next[LISTING_CURSOR_LEN + 1];
+    int count;
+    
+    CHECK(engineListReservations(engine, filter, cursor, rows, PAGE_SIZE, &count, next) == ENGINE_OK);
+    for (int i = 0; i < count; i++) {
+        if (last->pnr[0]) {
+            CHECK(compareListing(order, last, &rows[i]) < 0);
+        }
+        CHECK(rows[i].isBooked);
+        markSeen(&rows[i]);
+        *last = rows[i];
+    }
+    snprintf(cursor, LISTING_CURSOR_LEN + 1, "%s", next);
+    return count;
+}
+
+/**
+ * Read the remaining pages after a cursor
+ */
+static void readRemaining(ReservationEngine *engine, const ListingFilter *filter, int order,
+                          char *cursor, Passenger *last) {
+    int pages = 0;
+    while (cursor[0] && pages++ < MAX_EXPECTED) {
+        readPage(engine, filter, order, cursor, last);
+    }
+}
+
+/**
+ * Check every row was listed exactly when it should have been
+ */
+static void checkExpected() {
+    for (int i = 0; i < expectedCount; i++) {
+        if (expectedRows[i].seen != expectedRows[i].expected) {
+            printf("FAIL: PNR %s listed %d times, expected %d\n",
+                   expectedRows[i].pnr, expectedRows[i].seen, expectedRows[i].expected);
+            checkFailures++;
+        }
+    }
+}
+
+/**
+ * Forget which rows were seen and expect the active ones with a name prefix
+ */
+static void resetExpected(const char *prefix) {
+    for (int i = 0; i < expectedCount; i++) {
+        expectedRows[i].expected = expectedRows[i].active &&
+                                   strncasecmp(expectedRows[i].name, prefix, strlen(prefix)) == 0;
+        expectedRows[i].seen = 0;
+    }
+}
+
+int main() {
+    ReservationEngine engine;
+    ListingFilter filter;
+    Passenger last;
+    char cursor[LISTING_CURSOR_LEN + 1] = "";
+    char name[MAX_NAME_LEN + 1];
+    
+    openTestEngine(&engine, NULL);
+    for (int flightNumber = 400; flightNumber <= 403; flightNumber++) {
+        CHECK(addTestFlight(&engine, flightNumber, "Pune", "Goa", "2031-07-01", "10:00") == ENGINE_OK);
+    }
+    
+    // Even-numbered names on flights 401-403, leaving room to book between them
+    for (int i = 0; i < 60; i++) {
+        snprintf(name, sizeof(name), "P-%03d", 100 + 2 * i);
+        bookExpected(&engine, 401 + i / 20, name, 1);
+    }
+    for (int i = 1; i < expectedCount; i++) {
+        for (int j = 0; j < i; j++) {
+            CHECK(strcmp(expectedRows[i].pnr, expectedRows[j].pnr) != 0);  // Every booking gets its own PNR
+        }
+    }
+    
+    // By flight: the first page ends inside flight 401
+    memset(&filter, 0, sizeof(filter));
+    filter.status = EXPORT_STATUS_ACTIVE;
+    memset(&last, 0, sizeof(last));
+    CHECK(readPage(&engine, &filter, LISTING_ORDER_FLIGHT, cursor, &last) == PAGE_SIZE);
+    CHECK(cursor[0] != '\0' && last.flightNumber == 401);
+    
+    for (int i = 0; i < 5; i++) {
+        bookExpected(&engine, 400, "Before Cursor", 0);
+        bookExpected(&engine, 403, "After Cursor", 1);
+    }
+    CHECK(engineCancel(&engine, expectedRows[25].pnr, NULL) == ENGINE_OK);  // On flight 402
+    expectedRows[25].active = 0;
+    expectedRows[25].expected = 0;
+    
+    readRemaining(&engine, &filter, LISTING_ORDER_FLIGHT, cursor, &last);
+    checkExpected();
+    
+    // By name: the first page ends at P-118
+    resetExpected("P-");
+    memset(&filter, 0, sizeof(filter));
+    filter.status = EXPORT_STATUS_ACTIVE;
+    snprintf(filter.namePrefix, sizeof(filter.namePrefix), "P-");
+    memset(&last, 0, sizeof(last));
+    cursor[0] = '\0';
+    CHECK(readPage(&engine, &filter, LISTING_ORDER_NAME, cursor, &last) == PAGE_SIZE);
+    CHECK(strcmp(last.name, "P-118") == 0);
+    
+    bookExpected(&engine, 400, "P-101", 0);
+    bookExpected(&engine, 400, "p-117", 0);  // Names compare case-insensitively
+    bookExpected(&engine, 400, "P-119", 1);
+    bookExpected(&engine, 400, "P-999", 1);
+    bookExpected(&engine, 400, "Q-120", 0);  // Outside the prefix
+    
+    readRemaining(&engine, &filter, LISTING_ORDER_NAME, cursor, &last);
+    checkExpected();
+    
+    engineClose(&engine);
+    return checkResult("listing cursor");
+}
@@ -0,0 +1,211 @@
+/*
+ * A follower that replays the primary's change log ends up with the same
+ * flights and reservations as the primary, whether it catches up in one
+ * pass or across restarts, and refuses to replay a log that was started
+ * over under it.
+ */
+
+#include "../engine.c"
+#include "check.h"
+
+#define FOLLOWER_DIR "follower"
+#define FOLLOW_LOG_DIR "../" CHANGE_LOG_DIR
+
+static int digestPipe[2];
+
+typedef struct {
+    unsigned long long sum;           // Order-independent: records may be stored in any order
+    long records;
+} Digest;
+
+/**
+ * FNV-1a over a field, continuing from a previous hash
+ */
+static unsigned long long hashBytes(unsigned long long hash, const void *data, size_t length) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Add one reservation to a digest, field by field so padding is ignored
+ */
+static int digestReservation(const Passenger *p, void *arg) {
+    Digest *digest = arg;
+    unsigned long long hash = 14695981039346656037ULL;
+    hash = hashBytes(hash, p->name, strlen(p->name));
+    hash = hashBytes(hash, &p->age, sizeof(p->age));
+    hash = hashBytes(hash, &p->gender, sizeof(p->gender));
+    hash = hashBytes(hash, &p->seatNumber, sizeof(p->seatNumber));
+    hash = hashBytes(hash, p->pnr, strlen(p->pnr));
+    hash = hashBytes(hash, &p->flightNumber, sizeof(p->flightNumber));
+    hash = hashBytes(hash, &p->fare, sizeof(p->fare));
+    hash = hashBytes(hash, &p->paymentMethod, sizeof(p->paymentMethod));
+    hash = hashBytes(hash, &p->isBooked, sizeof(p->isBooked));
+    digest->sum += hash;
+    digest->records++;
+    return 1;
+}
+
+/**
+ * Digest every flight and reservation an engine can see
+ */
+static Digest digestEngine(ReservationEngine *engine) {
+    Digest digest;
+    const Flight *flights;
+    memset(&digest, 0, sizeof(digest));
+    
+    int count = engineFlights(engine, &flights);
+    for (int i = 0; i < count; i++) {
+        const Flight *f = &flights[i];
+        unsigned long long hash = 14695981039346656037ULL;
+        hash = hashBytes(hash, &f->flightNumber, sizeof(f->flightNumber));
+        hash = hashBytes(hash, f->departure, strlen(f->departure));
+        hash = hashBytes(hash, f->destination, strlen(f->destination));
+        hash = hashBytes(hash, f->date, strlen(f->date));
+        hash = hashBytes(hash, f->time, strlen(f->time));
+        hash = hashBytes(hash, &f->availableSeats, sizeof(f->availableSeats));
+        hash = hashBytes(hash, &f->fare, sizeof(f->fare));
+        hash = hashBytes(hash, &f->baseFare, sizeof(f->baseFare));
+        hash = hashBytes(hash, &f->fareBucket, sizeof(f->fareBucket));
+        digest.sum += hash;
+    }
+    engineScanReservations(engine, digestReservation, &digest);
+    return digest;
+}
+
+/**
+ * Send an engine's digest to the parent
+ */
+static int sendDigest(ReservationEngine *engine) {
+    Digest digest = digestEngine(engine);
+    return write(digestPipe[1], &digest, sizeof(digest)) == sizeof(digest) ? 0 : 1;
+}
+
+/**
+ * Receive a digest sent by a child
+ */
+static Digest receiveDigest() {
+    Digest digest;
+    if (read(digestPipe[0], &digest, sizeof(digest)) != sizeof(digest)) {
+        memset(&digest, 0, sizeof(digest));
+        digest.records = -1;
+    }
+    return digest;
+}
+
+/**
+ * First batch of primary changes: flights, bookings, a cancellation and a
+ * change of flight
+ */
+static int primaryFirstChanges(void *arg) {
+    ReservationEngine engine;
+    Passenger booked, changes;
+    char firstPnr[PNR_LEN + 1] = "";
+    int failures = 0;
+    (void)arg;
+    
+    openTestEngine(&engine, NULL);
+    failures += addTestFlight(&engine, 301, "Pune", "Goa", "2031-06-01", "08:00") != ENGINE_OK;
+    failures += addTestFlight(&engine, 302, "Goa", "Pune", "2031-06-02", "18:30") != ENGINE_OK;
+    failures += addTestFlight(&engine, 303, "Pune", "Delhi", "2031-06-03", "06:15") != ENGINE_OK;
+    for (int seat = 1; seat <= 40; seat++) {
+        int flightNumber = 301 + seat % 3;
+        if (bookTestSeat(&engine, flightNumber, seat, "Primary Passenger", &booked) != ENGINE_OK) {
+            failures++;
+        } else if (seat == 1) {
+            snprintf(firstPnr, sizeof(firstPnr), "%s", booked.pnr);
+        } else if (seat % 7 == 0) {
+            failures += engineCancel(&engine, booked.pnr, NULL) != ENGINE_OK;
+        }
+    }
+    
+    // Seat 1 is on flight 302; move it to 301, where seat 1 is still free
+    memset(&changes, 0, sizeof(changes));
+    snprintf(changes.name, sizeof(changes.name), "Renamed Passenger");
+    changes.age = 52;
+    changes.gender = 'M';
+    changes.paymentMethod = 3;
+    changes.flightNumber = 301;
+    changes.seatNumber = 1;
+    failures += engineModify(&engine, firstPnr, &changes, NULL) != ENGINE_OK;
+    
+    failures += sendDigest(&engine);
+    engineClose(&engine);
+    return failures;
+}
+
+/**
+ * Second batch: more bookings, then a flight is deleted
+ */
+static int primaryMoreChanges(void *arg) {
+    ReservationEngine engine;
+    int failures = 0;
+    (void)arg;
+    
+    openTestEngine(&engine, NULL);
+    for (int seat = 41; seat <= 60; seat++) {
+        failures += bookTestSeat(&engine, 301, seat, "Later Passenger", NULL) != ENGINE_OK;
+    }
+    failures += addTestFlight(&engine, 304, "Delhi", "Pune", "2031-06-04", "21:00") != ENGINE_OK;
+    failures += engineDeleteFlight(&engine, 303, NULL) != ENGINE_OK;
+    failures += sendDigest(&engine);
+    engineClose(&engine);
+    return failures;
+}
+
+/**
+ * Open the follower in its own directory, catch up and send its digest
+ * Exits with 2 if catching up failed
+ */
+static int followerCatchUp(void *arg) {
+    ReservationEngine engine;
+    (void)arg;
+    
+    if (chdir(FOLLOWER_DIR) != 0) {
+        return 1;
+    }
+    openTestEngine(&engine, FOLLOW_LOG_DIR);
+    if (engineCatchUp(&engine) < 0) {
+        engineClose(&engine);
+        return 2;
+    }
+    int failed = sendDigest(&engine);
+    engineClose(&engine);
+    return failed;
+}
+
+int main() {
+    CHECK(pipe(digestPipe) == 0);
+    CHECK(mkdir(FOLLOWER_DIR, 0755) == 0);
+    
+    // Follower replays the whole log in one pass
+    CHECK(runChild(primaryFirstChanges, NULL) == 0);
+    Digest primary = receiveDigest();
+    CHECK(runChild(followerCatchUp, NULL) == 0);
+    Digest follower = receiveDigest();
+    CHECK(primary.records > 0);
+    CHECK(follower.records == primary.records && follower.sum == primary.sum);
+    
+    // A restarted follower picks up from its saved position
+    CHECK(runChild(primaryMoreChanges, NULL) == 0);
+    primary = receiveDigest();
+    CHECK(runChild(followerCatchUp, NULL) == 0);
+    follower = receiveDigest();
+    CHECK(follower.records == primary.records && follower.sum == primary.sum);
+    
+    // Nothing new to apply: still the same state
+    CHECK(runChild(followerCatchUp, NULL) == 0);
+    follower = receiveDigest();
+    CHECK(follower.records == primary.records && follower.sum == primary.sum);
+    
+    // The primary starts a new log (as after a data upgrade); the follower
+    // must ask to be rebuilt instead of replaying it from its old position
+    writeChangeLogId(CHANGE_LOG_DIR);
+    CHECK(runChild(followerCatchUp, NULL) == 2);
+    
+    return checkResult("replica catch-up");
+}
@@ -0,0 +1,112 @@
+/*
+ * A schedule import adds the valid rows in file order and rejects, by
+ * line, rows whose flight number is already scheduled or appears earlier
+ * in the same file.
+ */
+
+#include "../engine.c"
+#include "check.h"
+
+#define SCHEDULE_FILE "schedule.csv"
+#define EXPORT_FILE "exported.csv"
+
+static const char *scheduleLines[] = {
+    "flight,departure,destination,date,time,duration_minutes,base_fare,fare,available_seats",
+    "610,Pune,Goa,2031-08-01,06:00,75,120.00,120.00,100",
+    "601,Pune,Delhi,2031-08-01,07:00,120,200.00,200.00,100",
+    "611,Goa,Pune,2031-08-01,09:30,75,110.00,110.00,100",
+    "610,Goa,Delhi,2031-08-02,06:00,150,250.00,250.00,100",
+    "612,Delhi,Goa,2031-08-02,12:00,150,240.00,240.00,100",
+    "612,Delhi,Pune,2031-08-03,12:00,120,180.00,180.00,100",
+    "613,Delhi,Pune,2031-13-40,12:00,120,180.00,180.00,100",
+    "602,Goa,Pune,2031-08-04,18:00,75,90.00,90.00,100",
+};
+
+static const char *expectedReport[] = {
+    "Line 3 rejected: flight number already exists",
+    "Line 5 rejected: duplicate flight number in file",
+    "Line 7 rejected: duplicate flight number in file",
+    "Line 8 rejected: invalid date",
+    "Line 9 rejected: flight number already exists",
+};
+
+/**
+ * Write the schedule file, one line per entry
+ */
+static int writeSchedule() {
+    FILE *fp = fopen(SCHEDULE_FILE, "w");
+    if (!fp) {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(scheduleLines) / sizeof(scheduleLines[0]); i++) {
+        fprintf(fp, "%s\n", scheduleLines[i]);
+    }
+    return fclose(fp) == 0;
+}
+
+/**
+ * Check the rejection report lists exactly the expected lines, in order
+ */
+static void checkReport(FILE *report) {
+    char line[256];
+    size_t count = 0, expected = sizeof(expectedReport) / sizeof(expectedReport[0]);
+    
+    rewind(report);
+    while (fgets(line, sizeof(line), report)) {
+        line[strcspn(line, "\n")] = '\0';
+        if (count >= expected || strcmp(line, expectedReport[count]) != 0) {
+            printf("FAIL: unexpected report line \"%s\"\n", line);
+            checkFailures++;
+        }
+        count++;
+    }
+    CHECK(count == expected);
+}
+
+int main() {
+    ReservationEngine engine;
+    const Flight *flights;
+    long rejected;
+    
+    openTestEngine(&engine, NULL);
+    CHECK(addTestFlight(&engine, 601, "Pune", "Mumbai", "2031-07-30", "08:00") == ENGINE_OK);
+    CHECK(addTestFlight(&engine, 602, "Mumbai", "Pune", "2031-07-30", "20:00") == ENGINE_OK);
+    CHECK(writeSchedule());
+    
+    FILE *report = tmpfile();
+    CHECK(report != NULL);
+    CHECK(engineImportSchedule(&engine, SCHEDULE_FILE, &rejected, report) == 3);
+    CHECK(rejected == 5);
+    if (report) {
+        checkReport(report);
+        fclose(report);
+    }
+    
+    // Accepted rows follow the existing flights in file order; the first
+    // row of a repeated number wins, and existing flights are untouched
+    int expectedNumbers[] = { 601, 602, 610, 611, 612 };
+    int count = engineFlights(&engine, &flights);
+    CHECK(count == 5);
+    for (int i = 0; i < count && i < 5; i++) {
+        CHECK(flights[i].flightNumber == expectedNumbers[i]);
+        CHECK(flights[i].availableSeats == MAX_SEATS);
+    }
+    if (count == 5) {
+        CHECK(strcmp(flights[0].destination, "Mumbai") == 0);
+        CHECK(strcmp(flights[2].destination, "Goa") == 0 && flights[2].durationMinutes == 75);
+        CHECK(strcmp(flights[4].destination, "Goa") == 0 && flights[4].baseFare == 240.0f);
+    }
+    
+    // Importing the same file again adds nothing
+    CHECK(engineImportSchedule(&engine, SCHEDULE_FILE, &rejected, NULL) == 0);
+    CHECK(rejected == 8);
+    
+    // An exported schedule reads back in the import layout, every row a duplicate
+    CHECK(engineExportFlights(&engine, EXPORT_FILE, EXPORT_FORMAT_CSV) == 5);
+    CHECK(engineImportSchedule(&engine, EXPORT_FILE, &rejected, NULL) == 0);
+    CHECK(rejected == 5);
+    CHECK(engineFlights(&engine, &flights) == 5);
+    
+    engineClose(&engine);
+    return checkResult("schedule import");
+}
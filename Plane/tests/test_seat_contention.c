@@ -0,0 +1,220 @@
+/*
+ * Sessions in separate processes competing for the same seats: every seat
+ * is booked exactly once, and a held seat cannot be taken by another
+ * session until the hold is used. The fare quoted with a hold is the only
+ * fare a caller can ask to be charged.
+ */
+
+#include "../engine.c"
+#include "check.h"
+
+#define CONTENTION_FLIGHT 101
+#define HOLD_FLIGHT 102
+#define CONTENTION_PROCESSES 4
+
+static int resultPipe[2];
+static int heldPipe[2];               // Holder -> taker: the seat is held
+static int triedPipe[2];              // Taker -> holder: done trying
+
+/**
+ * Add the flights every session uses
+ */
+static int setUpFlights(void *arg) {
+    ReservationEngine engine;
+    (void)arg;
+    openTestEngine(&engine, NULL);
+    int ok = addTestFlight(&engine, CONTENTION_FLIGHT, "Pune", "Goa", "2031-05-01", "08:00") == ENGINE_OK &&
+             addTestFlight(&engine, HOLD_FLIGHT, "Pune", "Delhi", "2031-05-01", "09:00") == ENGINE_OK;
+    engineClose(&engine);
+    return ok ? 0 : 1;
+}
+
+/**
+ * Try to book every seat of the contended flight, reporting the count won
+ */
+static int bookEverySeat(void *arg) {
+    ReservationEngine engine;
+    int won = 0;
+    (void)arg;
+    
+    openTestEngine(&engine, NULL);
+    for (int seat = 1; seat <= MAX_SEATS; seat++) {
+        if (bookTestSeat(&engine, CONTENTION_FLIGHT, seat, "Racing Passenger", NULL) == ENGINE_OK) {
+            won++;
+        }
+    }
+    engineClose(&engine);
+    return write(resultPipe[1], &won, sizeof(won)) == sizeof(won) ? 0 : 1;
+}
+
+/**
+ * Hold seat 7, wait for the other session to try it, then book it
+ */
+static int holdAndBook(void *arg) {
+    ReservationEngine engine;
+    BookingRequest request;
+    int hold, failures = 0;
+    char signal = 1;
+    (void)arg;
+    
+    openTestEngine(&engine, NULL);
+    memset(&request, 0, sizeof(request));
+    if (engineHoldSeat(&engine, HOLD_FLIGHT, 7, &hold, &request.fare) != ENGINE_OK) {
+        failures++;
+    }
+    if (write(heldPipe[1], &signal, 1) != 1 || read(triedPipe[0], &signal, 1) != 1) {
+        failures++;
+    }
+    
+    snprintf(request.name, sizeof(request.name), "Holding Passenger");
+    request.age = 40;
+    request.gender = 'M';
+    request.flightNumber = HOLD_FLIGHT;
+    request.seatNumber = 7;
+    request.paymentMethod = 2;
+    request.hold = hold;
+    Passenger booked;
+    if (engineBook(&engine, &request, &booked) != ENGINE_OK || booked.fare != request.fare) {
+        failures++;
+    }
+    engineClose(&engine);
+    return failures;
+}
+
+/**
+ * Try to hold and to book seat 7 while the other session holds it
+ * Exits with a bit set for each attempt that was not refused as held
+ */
+static int takeHeldSeat(void *arg) {
+    ReservationEngine engine;
+    int hold, failures = 0;
+    char signal = 1;
+    (void)arg;
+    
+    openTestEngine(&engine, NULL);
+    if (read(heldPipe[0], &signal, 1) != 1) {
+        return 4;
+    }
+    if (engineHoldSeat(&engine, HOLD_FLIGHT, 7, &hold, NULL) != ENGINE_SEAT_HELD) {
+        failures |= 1;
+    }
+    if (bookTestSeat(&engine, HOLD_FLIGHT, 7, "Second Passenger", NULL) != ENGINE_SEAT_HELD) {
+        failures |= 2;
+    }
+    if (write(triedPipe[1], &signal, 1) != 1) {
+        failures |= 4;
+    }
+    engineClose(&engine);
+    return failures;
+}
+
+typedef struct {
+    int flightNumber;
+    int active;
+    int seatBookings[MAX_SEATS + 1];
+} SeatCount;
+
+/**
+ * Count one flight's active reservations per seat
+ */
+static int countSeat(const Passenger *p, void *arg) {
+    SeatCount *count = arg;
+    if (p->flightNumber == count->flightNumber && p->isBooked &&
+        p->seatNumber >= 1 && p->seatNumber <= MAX_SEATS) {
+        count->active++;
+        count->seatBookings[p->seatNumber]++;
+    }
+    return 1;
+}
+
+/**
+ * Start a child without waiting for it
+ */
+static pid_t startChild(int (*body)(void *arg)) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        int status = body(NULL);
+        fflush(stdout);
+        _exit(status);
+    }
+    return pid;
+}
+
+/**
+ * Wait for a started child and return its exit status
+ */
+static int finishChild(pid_t pid) {
+    int status;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+        return -1;
+    }
+    return WEXITSTATUS(status);
+}
+
+int main() {
+    CHECK(runChild(setUpFlights, NULL) == 0);
+    
+    // Every process tries every seat at once
+    CHECK(pipe(resultPipe) == 0);
+    pid_t racers[CONTENTION_PROCESSES];
+    for (int i = 0; i < CONTENTION_PROCESSES; i++) {
+        racers[i] = startChild(bookEverySeat);
+    }
+    close(resultPipe[1]);
+    int won, totalWon = 0;
+    while (read(resultPipe[0], &won, sizeof(won)) == sizeof(won)) {
+        totalWon += won;
+    }
+    for (int i = 0; i < CONTENTION_PROCESSES; i++) {
+        CHECK(finishChild(racers[i]) == 0);
+    }
+    CHECK(totalWon == MAX_SEATS);
+    
+    // One session holds a seat while another tries to take it
+    CHECK(pipe(heldPipe) == 0 && pipe(triedPipe) == 0);
+    pid_t holder = startChild(holdAndBook);
+    pid_t taker = startChild(takeHeldSeat);
+    CHECK(finishChild(taker) == 0);
+    CHECK(finishChild(holder) == 0);
+    
+    // The stored state agrees with what the sessions were told
+    ReservationEngine engine;
+    Flight flight;
+    SeatCount count;
+    openTestEngine(&engine, NULL);
+    
+    memset(&count, 0, sizeof(count));
+    count.flightNumber = CONTENTION_FLIGHT;
+    engineScanReservations(&engine, countSeat, &count);
+    CHECK(count.active == MAX_SEATS);
+    for (int seat = 1; seat <= MAX_SEATS; seat++) {
+        CHECK(count.seatBookings[seat] == 1);
+    }
+    CHECK(engineFindFlight(&engine, CONTENTION_FLIGHT, &flight) == ENGINE_OK && flight.availableSeats == 0);
+    
+    memset(&count, 0, sizeof(count));
+    count.flightNumber = HOLD_FLIGHT;
+    engineScanReservations(&engine, countSeat, &count);
+    CHECK(count.active == 1 && count.seatBookings[7] == 1);
+    CHECK(engineFindFlight(&engine, HOLD_FLIGHT, &flight) == ENGINE_OK && flight.availableSeats == MAX_SEATS - 1);
+    
+    // A fare the engine did not quote with a hold is not charged
+    BookingRequest request;
+    Passenger booked;
+    float quote;
+    memset(&request, 0, sizeof(request));
+    snprintf(request.name, sizeof(request.name), "Bargain Passenger");
+    request.age = 35;
+    request.gender = 'F';
+    request.flightNumber = HOLD_FLIGHT;
+    request.seatNumber = 8;
+    request.paymentMethod = 1;
+    request.fare = 0.01f;
+    request.hold = -1;
+    CHECK(engineQuote(&engine, HOLD_FLIGHT, &quote) == ENGINE_OK);
+    CHECK(engineBook(&engine, &request, &booked) == ENGINE_OK && booked.fare == quote);
+    
+    engineClose(&engine);
+    return checkResult("seat contention");
+}